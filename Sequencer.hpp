@@ -15,6 +15,7 @@
 
  #pragma once
 
+ #include <algorithm>
  #include <cstdint>
  #include <functional>
  #include <thread>
@@ -25,6 +26,10 @@
  #include <chrono>  
  #include <fstream>  
  #include <syslog.h>
+ #include <atomic>
+ #include <memory>
+ #include <semaphore>
+ #include "pi_mutex.hpp"
  #define NSEC_PER_SEC (1000000000)
  
  // The service class contains the service function and service parameters
@@ -49,7 +54,9 @@
          syslog(LOG_INFO, "affinity %d \n", static_cast<int>(_affinity));
          syslog(LOG_INFO, "priority  %d \n", static_cast<int>(_priority));
          syslog(LOG_INFO, "period %d   \n", static_cast<int>(_period));
-           std::ofstream clear_file("service_runs" + std::to_string(_service_indetifier) + "_.csv"); //clear previous logs
+         // clear previous logs; kept open, an open/close per run costs every
+         // run a few syscalls and wakes the config service's directory watch
+         _run_log.open("service_runs" + std::to_string(_service_indetifier) + "_.csv", std::ios::trunc);
          _service = std::jthread(&Service::_provideService, this);
      }
  
@@ -58,13 +65,42 @@
          // todo: change state to "not running" using an atomic variable
          // (heads up: what if the service is waiting on the semaphore when this happens?)
          _running = false;
-         _semaphore.release();
+         release();
      }
  
      void release()
      {
          // todo: release the service using the semaphore
-         _semaphore.release();
+         // a release while one is still pending is merged into it, the
+         // binary semaphore must never be released twice
+         if (!_pending.exchange(true))
+         {
+             _semaphore.release();
+         }
+     }
+
+     // Precedence: release `next` each time this service completes having
+     // produced new data (see produced()). If `next` also has a period, the
+     // timer only releases it when no upstream did during that period.
+     void precedes(Service &next)
+     {
+         if (std::find(_successors.begin(), _successors.end(), &next) == _successors.end())
+         {
+             _successors.push_back(&next);
+         }
+         next._chained = true;
+     }
+
+     // Called from inside the service function, by whatever it publishes
+     void produced()
+     {
+         _produced.store(true, std::memory_order_relaxed);
+     }
+
+     // The period elapsed: release unless an upstream already did
+     bool timerDue()
+     {
+         return !_chained || !_data_released.exchange(false);
      }
  
      int get_period()
@@ -81,24 +117,39 @@
  syslog(LOG_INFO, "  Max Execution Time    : %.3f ms (%.0f ns)", _max_execution_time, _max_execution_time * 1e6);
  syslog(LOG_INFO, "  Avg Execution Time    : %.3f ms (%.0f ns)", avg_time, avg_time * 1e6);
  syslog(LOG_INFO, "  Jitter  : %.3f ms (%.0f ns)", _max_execution_time-_min_execution_time, (_max_execution_time-_min_execution_time) * 1e6);
+ if (_chained)
+ {
+ syslog(LOG_INFO, "  Released by upstream  : %llu", (unsigned long long)_data_releases.load());
+ }
  
      }
  
  private:
      std::function<void(void)> _doService;
-     std::jthread _service;
      int _affinity;
      int _priority;
      int _period;
      int _service_indetifier;
      std::binary_semaphore _semaphore;
+     std::ofstream _run_log;
+     std::atomic<bool> _pending{false};  // released, not yet picked up
      std::atomic<bool> _running{true}; // Atomic boolean initialized to true
+
+     // precedence chain
+     std::vector<Service *> _successors;
+     bool _chained = false;                  // has an upstream service
+     std::atomic<bool> _produced{false};     // set during the current run
+     std::atomic<bool> _data_released{false};
+     std::atomic<uint64_t> _data_releases{0};
                                        
                                        // logging data
      double _min_execution_time = std::numeric_limits<double>::max();
      double _max_execution_time = std::numeric_limits<double>::min();
      double _accum_exec_time = 0;
      uint64_t _exec_count = 0;
+
+     // last, so the thread is joined before the members it uses go away
+     std::jthread _service;
  
  
      void _initializeService()
@@ -123,6 +174,9 @@
              syslog(LOG_ERR, "Failed to set scheduling parameters.");
          }
  
+         // lock waits of this thread are charged to this service
+         lock_service_id = _service_indetifier;
+
          syslog(LOG_INFO, "Service initialized with affinity %d and priority %d", _affinity, _priority);
      }
      
@@ -139,12 +193,9 @@
      delta_t(&service_end, &service_start, &service_exec);
      double run_time = (service_exec.tv_sec * 1000.0) + (service_exec.tv_nsec / 1000000.0);
  
-     std::ofstream run_time_logs;
-     run_time_logs.open("service_runs" + std::to_string(_service_indetifier) + "_.csv", std::ios::app);
-     if (run_time_logs.is_open())
+     if (_run_log.is_open())
      {
-         run_time_logs << run_time << "\n";
-         run_time_logs.close();
+         _run_log << run_time << "\n";
      }
  
      _exec_count++;
@@ -167,8 +218,25 @@
          else
          {
              _semaphore.acquire();
+             _pending = false;
+             if (!_running)
+             {
+                 break;
+             }
              _runAndLog();
          }
+
+         // upstream done with new data: release the consumers now rather
+         // than at their next period
+         if (_produced.exchange(false, std::memory_order_relaxed))
+         {
+             for (Service *next : _successors)
+             {
+                 next->_data_released = true;
+                 next->_data_releases.fetch_add(1, std::memory_order_relaxed);
+                 next->release();
+             }
+         }
      }
  }
  
@@ -215,11 +283,12 @@
  {
  public:
      template <typename... Args>
-     void addService(Args &&...args)
+     Service &addService(Args &&...args)
      {
          // Add the new service to the services list,
          // constructing it in-place with the given args
          _services.emplace_back(std::make_unique<Service>(std::forward<Args>(args)...));
+         return *_services.back();
      }
  
      void startServices()
@@ -275,7 +344,10 @@
         uint64_t tick_time = ++_tick_counter;
         for (auto &service : _services)
         {
-            if (tick_time % service->get_period() == 0)
+            // free-running services (period <= 0) release themselves,
+            // chained ones skip periods in which upstream released them
+            if (service->get_period() > 0 && tick_time % service->get_period() == 0 &&
+                service->timerDue())
             {
                 service->release();
             }
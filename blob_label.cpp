@@ -0,0 +1,256 @@
+/***************************************************************
+ * File: blob_label.cpp
+ * Description: Run-based union-find labeller and blob scoring.
+ ***************************************************************/
+
+#include "blob_label.hpp"
+
+#include <cstring>
+#include <limits>
+#include <vector>
+
+bool parse_blob_score(const char* name, BlobScore& score)
+{
+    if (strcmp(name, "largest") == 0) score = BLOB_LARGEST;
+    else if (strcmp(name, "brightest") == 0) score = BLOB_BRIGHTEST;
+    else if (strcmp(name, "closest") == 0) score = BLOB_CLOSEST;
+    else return false;
+    return true;
+}
+
+uint32_t BlobLabeller::_find(std::vector<Run>& runs, uint32_t i)
+{
+    while (runs[i].parent != i) {
+        runs[i].parent = runs[runs[i].parent].parent;   // path halving
+        i = runs[i].parent;
+    }
+    return i;
+}
+
+// first set byte at or after x, `width` if none; skips zero words
+static int next_set(const uint8_t* row, int x, int width)
+{
+    while (x < width && (x & 7)) {
+        if (row[x]) return x;
+        ++x;
+    }
+    while (x + 8 <= width) {
+        uint64_t w;
+        memcpy(&w, row + x, 8);
+        if (w) break;
+        x += 8;
+    }
+    while (x < width && !row[x]) ++x;
+    return x;
+}
+
+void BlobLabeller::_emit(int cls, int x0, int x1, int y)
+{
+    std::vector<Run>& runs = _runs[cls];
+    uint32_t id = uint32_t(runs.size());
+    runs.push_back({x0, x1, y, id});
+
+    // previous-row runs of this class touching [x0 - 1, x1 + 1]; runs are
+    // sorted, so the scan resumes where the last run of the row left off
+    size_t& p = _next[cls];
+    while (p < _prev_end[cls] && runs[p].x1 < x0 - 1) ++p;
+    for (size_t q = p; q < _prev_end[cls] && runs[q].x0 <= x1 + 1; ++q) {
+        // the older run stays root so labels follow raster order
+        uint32_t a = _find(runs, id), b = _find(runs, uint32_t(q));
+        if (a < b) runs[b].parent = a;
+        else if (b < a) runs[a].parent = b;
+    }
+}
+
+int BlobLabeller::label(const cv::Mat& mask, const uint8_t* yuyv, size_t stride, uint32_t min_area)
+{
+    _acc.clear();
+    _blobs.clear();
+    _top.clear();
+    _bottom.clear();
+    for (int c = 0; c < MASK_CLASS_BITS; ++c) {
+        _runs[c].clear();
+        _prev_begin[c] = _prev_end[c] = 0;
+    }
+
+    size_t row_begin[MASK_CLASS_BITS];
+    for (int y = 0; y < mask.rows; ++y) {
+        const uint8_t* row = mask.ptr<uint8_t>(y);
+        for (int c = 0; c < MASK_CLASS_BITS; ++c) {
+            row_begin[c] = _runs[c].size();
+            _next[c] = _prev_begin[c];
+        }
+
+        // within a stretch of non-zero bytes a class run starts where its
+        // bit turns on and ends where it turns off
+        int x = next_set(row, 0, mask.cols);
+        while (x < mask.cols) {
+            int start[MASK_CLASS_BITS];
+            unsigned open = 0;
+            for (; x < mask.cols && row[x]; ++x) {
+                unsigned bits = row[x];
+                if (bits == open) continue;
+                for (unsigned ended = open & ~bits; ended; ended &= ended - 1) {
+                    int c = __builtin_ctz(ended);
+                    _emit(c, start[c], x - 1, y);
+                }
+                for (unsigned started = bits & ~open; started; started &= started - 1) {
+                    start[__builtin_ctz(started)] = x;
+                }
+                open = bits;
+            }
+            for (; open; open &= open - 1) {
+                int c = __builtin_ctz(open);
+                _emit(c, start[c], x - 1, y);
+            }
+            x = next_set(row, x, mask.cols);
+        }
+
+        for (int c = 0; c < MASK_CLASS_BITS; ++c) {
+            _prev_begin[c] = row_begin[c];
+            _prev_end[c] = _runs[c].size();
+        }
+    }
+
+    // sum runs into their roots, class by class
+    for (int c = 0; c < MASK_CLASS_BITS; ++c) {
+        std::vector<Run>& runs = _runs[c];
+        if (runs.empty()) continue;
+        _blob_of.assign(runs.size(), -1);
+
+        for (uint32_t i = 0; i < runs.size(); ++i) {
+            const Run& r = runs[i];
+            uint32_t root = _find(runs, i);
+            if (_blob_of[root] < 0) {
+                _blob_of[root] = int32_t(_acc.size());
+                _acc.push_back({c, 0, 0, 0, 0, r.x0, r.y, r.x1, r.y});
+            }
+            Blob& b = _acc[_blob_of[root]];
+
+            uint32_t n = uint32_t(r.x1 - r.x0 + 1);
+            b.area += n;
+            b.m10 += uint64_t(r.x0 + r.x1) * n / 2;
+            b.m01 += uint64_t(r.y) * n;
+            if (yuyv) {
+                const uint8_t* p = yuyv + size_t(r.y) * stride + size_t(r.x0) * 2;
+                for (uint32_t k = 0; k < n; ++k) b.luma += p[k * 2];
+            }
+            if (r.x0 < b.x0) b.x0 = r.x0;
+            if (r.x1 > b.x1) b.x1 = r.x1;
+            b.y1 = r.y;
+        }
+
+        for (uint32_t i = 0; i < runs.size() && runs[i].y == 0; ++i) {
+            _top.push_back({c, runs[i].x0, runs[i].x1, _blob_of[_find(runs, i)]});
+        }
+        for (size_t i = _prev_begin[c]; i < _prev_end[c] && runs[i].y == mask.rows - 1; ++i) {
+            _bottom.push_back({c, runs[i].x0, runs[i].x1, _blob_of[_find(runs, uint32_t(i))]});
+        }
+    }
+    _components = int(_acc.size());
+
+    for (const Blob& b : _acc) {
+        if (b.area >= min_area) _blobs.push_back(b);
+    }
+    return int(_blobs.size());
+}
+
+const Blob* best_blob(const std::vector<Blob>& blobs, int cls, BlobScore score, bool has_prev,
+                      int px, int py)
+{
+    if (score == BLOB_CLOSEST && !has_prev) score = BLOB_LARGEST;
+
+    const Blob* best = nullptr;
+    double best_value = -std::numeric_limits<double>::max();
+    for (const Blob& b : blobs) {
+        if (b.cls != cls) continue;
+        double value;
+        switch (score) {
+            case BLOB_BRIGHTEST:
+                value = double(b.luma) / b.area;
+                break;
+            case BLOB_CLOSEST: {
+                double dx = b.cx() - px, dy = b.cy() - py;
+                value = -(dx * dx + dy * dy);
+                break;
+            }
+            default:
+                value = b.area;
+                break;
+        }
+        if (value > best_value) {
+            best_value = value;
+            best = &b;
+        }
+    }
+    return best;
+}
+
+static uint32_t find_root(std::vector<uint32_t>& parent, uint32_t i)
+{
+    while (parent[i] != i) {
+        parent[i] = parent[parent[i]];
+        i = parent[i];
+    }
+    return i;
+}
+
+void merge_stripe_blobs(const BlobLabeller* stripes, const int* row0, int count,
+                        uint32_t min_area, std::vector<Blob>& blobs)
+{
+    blobs.clear();
+
+    std::vector<uint32_t> base(count + 1, 0);
+    for (int s = 0; s < count; ++s) base[s + 1] = base[s] + stripes[s].component_count();
+    std::vector<uint32_t> parent(base[count]);
+    for (uint32_t i = 0; i < parent.size(); ++i) parent[i] = i;
+
+    // runs of the same class on either side of a border touch when they
+    // overlap or meet diagonally; both lists are sorted by class, then x
+    for (int s = 0; s + 1 < count; ++s) {
+        const std::vector<BlobLabeller::EdgeRun>& above = stripes[s].bottom_runs();
+        const std::vector<BlobLabeller::EdgeRun>& below = stripes[s + 1].top_runs();
+        size_t p = 0;
+        for (const BlobLabeller::EdgeRun& b : below) {
+            while (p < above.size() &&
+                   (above[p].cls < b.cls || (above[p].cls == b.cls && above[p].x1 < b.x0 - 1))) {
+                ++p;
+            }
+            for (size_t q = p; q < above.size() && above[q].cls == b.cls && above[q].x0 <= b.x1 + 1; ++q) {
+                uint32_t ra = find_root(parent, base[s] + above[q].component);
+                uint32_t rb = find_root(parent, base[s + 1] + b.component);
+                if (ra < rb) parent[rb] = ra;
+                else if (rb < ra) parent[ra] = rb;
+            }
+        }
+    }
+
+    std::vector<int32_t> blob_of(parent.size(), -1);
+    std::vector<Blob> merged;
+    for (int s = 0; s < count; ++s) {
+        for (int c = 0; c < stripes[s].component_count(); ++c) {
+            Blob part = stripes[s].components()[c];
+            part.translate(0, row0[s]);
+
+            uint32_t root = find_root(parent, base[s] + c);
+            if (blob_of[root] < 0) {
+                blob_of[root] = int32_t(merged.size());
+                merged.push_back(part);
+                continue;
+            }
+            Blob& b = merged[blob_of[root]];
+            b.area += part.area;
+            b.m10 += part.m10;
+            b.m01 += part.m01;
+            b.luma += part.luma;
+            if (part.x0 < b.x0) b.x0 = part.x0;
+            if (part.x1 > b.x1) b.x1 = part.x1;
+            if (part.y0 < b.y0) b.y0 = part.y0;
+            if (part.y1 > b.y1) b.y1 = part.y1;
+        }
+    }
+
+    for (const Blob& b : merged) {
+        if (b.area >= min_area) blobs.push_back(b);
+    }
+}
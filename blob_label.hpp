@@ -0,0 +1,119 @@
+/***************************************************************
+ * File: blob_label.hpp
+ * Description: Streaming connected-component labelling of the class
+ *              mask. One raster pass collects runs of set pixels for
+ *              every class bit at once, joins runs of the same class that
+ *              touch the previous row (8-connectivity) with union-find,
+ *              and accumulates area, first moments and luma per run.
+ *              Components are the sums over their runs, so no contour is
+ *              traced and no per-pixel label image is kept.
+ ***************************************************************/
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+#include <opencv2/opencv.hpp>
+
+// Blobs smaller than this are noise. contourArea() >= 5, the old
+// contour filter, corresponds to roughly a 3x4 pixel block.
+#define BLOB_MIN_AREA 10
+
+// One class per mask bit
+#define MASK_CLASS_BITS 8
+
+// How the detector picks one blob per class and frame
+enum BlobScore {
+    BLOB_LARGEST,       // most pixels
+    BLOB_BRIGHTEST,     // highest mean luma
+    BLOB_CLOSEST        // nearest to the previous position (largest if none)
+};
+
+// "largest", "brightest" or "closest", false if unknown
+bool parse_blob_score(const char* name, BlobScore& score);
+
+struct Blob {
+    int cls;                    // mask bit the blob was labelled from
+    uint32_t area;
+    uint64_t m10, m01;          // sums of x and y over the blob's pixels
+    uint64_t luma;              // sum of Y, 0 without a luma source
+    int x0, y0, x1, y1;         // inclusive bounding box
+
+    double cx() const { return double(m10) / area; }
+    double cy() const { return double(m01) / area; }
+
+    // from window to frame coordinates, (dx, dy) is the window origin
+    void translate(int dx, int dy)
+    {
+        m10 += uint64_t(dx) * area;
+        m01 += uint64_t(dy) * area;
+        x0 += dx;
+        x1 += dx;
+        y0 += dy;
+        y1 += dy;
+    }
+};
+
+// Best blob of class `cls` under `score`; (px, py) is the previous
+// position for BLOB_CLOSEST, `has_prev` false if there is none.
+// nullptr if the class has no blob.
+const Blob* best_blob(const std::vector<Blob>& blobs, int cls, BlobScore score,
+                      bool has_prev = false, int px = 0, int py = 0);
+
+class BlobLabeller {
+public:
+    // A run on the first or last mask row and the component it belongs
+    // to, used to join components across stripe borders
+    struct EdgeRun {
+        int cls;
+        int x0, x1;             // inclusive
+        int component;          // index into components()
+    };
+
+    // Label a CV_8UC1 class mask. `yuyv`/`stride`, when given, is the packed
+    // frame the mask was built from (same origin) and feeds the luma sums.
+    // Returns the number of components of at least `min_area` pixels.
+    int label(const cv::Mat& mask, const uint8_t* yuyv = nullptr, size_t stride = 0,
+              uint32_t min_area = BLOB_MIN_AREA);
+
+    const std::vector<Blob>& blobs() const { return _blobs; }
+
+    // Best blob of one class of the last label() call, see best_blob()
+    const Blob* best(int cls, BlobScore score, bool has_prev = false, int px = 0, int py = 0) const
+    {
+        return best_blob(_blobs, cls, score, has_prev, px, py);
+    }
+
+    // Every component of the last label() call regardless of size, and
+    // the runs on the first/last mask row, ordered by class then x
+    const Blob* components() const { return _acc.data(); }
+    int component_count() const { return _components; }
+    const std::vector<EdgeRun>& top_runs() const { return _top; }
+    const std::vector<EdgeRun>& bottom_runs() const { return _bottom; }
+
+private:
+    struct Run {
+        int x0, x1, y;          // inclusive
+        uint32_t parent;
+    };
+
+    static uint32_t _find(std::vector<Run>& runs, uint32_t i);
+    void _emit(int cls, int x0, int x1, int y);
+
+    // reused between frames so labelling does not allocate once warm
+    std::vector<Run> _runs[MASK_CLASS_BITS];
+    size_t _prev_begin[MASK_CLASS_BITS], _prev_end[MASK_CLASS_BITS], _next[MASK_CLASS_BITS];
+    std::vector<Blob> _acc;
+    std::vector<int32_t> _blob_of;
+    std::vector<Blob> _blobs;
+    int _components = 0;
+    std::vector<EdgeRun> _top, _bottom;
+};
+
+// Join the labellers of horizontal stripes of one mask into blobs.
+// Stripe i covers mask rows starting at row0[i]; components touching
+// across a stripe border (8-connectivity) are merged, moments and
+// bounding boxes are shifted into whole-mask coordinates.
+void merge_stripe_blobs(const BlobLabeller* stripes, const int* row0, int count,
+                        uint32_t min_area, std::vector<Blob>& blobs);
@@ -1,110 +1,572 @@
-#include "cameraService.hpp"
-#include "watchdog.hpp"
-cv::Mat latest_frame;
-std::mutex frame_mutex;
-
-//a global context for camera
-CameraContext cam;
-
-
-int init_camera()
-{
-//open the device in a non blocking mode
-  const char* dev_name = CAM_DEVICE;
-     cam.fd = open(dev_name, O_RDWR | O_NONBLOCK);
-    if (cam.fd == -1) {
-        syslog(LOG_ERR,"ERROR Opening video device");
-        return EXIT_FAILURE;
-    }
-    
-    //set format
-    cam.fmt.type = V4L2_BUF_TYPE_VIDEO_CAPTURE;
-    cam.fmt.fmt.pix.width = FRAME_WIDTH;
-    cam.fmt.fmt.pix.height = FRAME_HEIGHT;
-    cam.fmt.fmt.pix.pixelformat = V4L2_PIX_FMT_YUYV;
-    cam.fmt.fmt.pix.field = V4L2_FIELD_NONE;
-    if (ioctl(cam.fd, VIDIOC_S_FMT, &cam.fmt) == -1) {
-        syslog(LOG_ERR,"ERROR Setting Pixel Format");
-         return EXIT_FAILURE;
-    }
-    
-    //request for buffer to store our frames
-    v4l2_requestbuffers req = {};
-    req.count = NBUF;
-    req.type = V4L2_BUF_TYPE_VIDEO_CAPTURE;
-    req.memory = V4L2_MEMORY_MMAP;
-    if (ioctl(cam.fd, VIDIOC_REQBUFS, &req) == -1) {
-        syslog(LOG_ERR,"ERROR Requesting Buffer");
-        return EXIT_FAILURE;
-    }
-    
-    //query and queue buffers
-    for (int i = 0; i < NBUF; ++i) {
-        v4l2_buffer buf = {};
-        buf.type = V4L2_BUF_TYPE_VIDEO_CAPTURE;
-        buf.memory = V4L2_MEMORY_MMAP;
-        buf.index = i;
-
-        if (ioctl(cam.fd, VIDIOC_QUERYBUF, &buf) == -1) {
-            syslog(LOG_ERR,"Querying Buffer failed");
-            return EXIT_FAILURE;
-        }
-
-        cam.buffers[i].length = buf.length;
-        cam.buffers[i].start = mmap(NULL, buf.length, PROT_READ | PROT_WRITE, MAP_SHARED, cam.fd, buf.m.offset);
-        
-        if (cam.buffers[i].start == MAP_FAILED) {
-            syslog(LOG_ERR,"mmap failed");
-          return EXIT_FAILURE;
-        }
-
-        if (ioctl(cam.fd, VIDIOC_QBUF, &buf) == -1) {
-            syslog(LOG_ERR,"Queue Buffer failed");
-            return EXIT_FAILURE;
-        }
-    }
-    // Start streaming
-    int type = V4L2_BUF_TYPE_VIDEO_CAPTURE;
-    if (ioctl(cam.fd, VIDIOC_STREAMON, &type) == -1) {
-        syslog(LOG_ERR,"error starting streaming");
-         return EXIT_FAILURE;
-    }
-    return EXIT_SUCCESS;
-}	
-
-
-void camera_capture_service() {
-    fd_set fds;
-    //int r;
- 
-        FD_ZERO(&fds);
-        FD_SET(cam.fd, &fds);
-
-
-        v4l2_buffer buf = {};
-        buf.type = V4L2_BUF_TYPE_VIDEO_CAPTURE;
-        buf.memory = V4L2_MEMORY_MMAP;
-
-        if (ioctl(cam.fd, VIDIOC_DQBUF, &buf) == -1) {
-            if (errno == EAGAIN) return;
-            syslog(LOG_ERR,"No frame data available service returning early");
-            return;
-        }
-
-        cv::Mat yuyv(FRAME_HEIGHT, FRAME_WIDTH, CV_8UC2, cam.buffers[buf.index].start);
-        cv::Mat bgr;
-        cv::cvtColor(yuyv, bgr, cv::COLOR_YUV2BGR_YUYV);
-
-        {
-            std::lock_guard<std::mutex> lock(frame_mutex);
-            latest_frame = bgr.clone();
-        }
-        if (ioctl(cam.fd, VIDIOC_QBUF, &buf) == -1) {
-			syslog(LOG_ERR,"error requeing buffer");
-            return;
-
-        }
-        service1_ok = true;
-        //syslog(LOG_INFO, "Service 1 OK set");
-    
-}
+#include "cameraService.hpp"
+#include "watchdog.hpp"
+#include "frame_recorder.hpp"
+#include "config_snapshot.hpp"
+#include "latency_trace.hpp"
+#include "debug_view.hpp"
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+#include <poll.h>
+#include <tuple>
+
+CaptureWake capture_wake = CAPTURE_ON_FRAME;
+bool capture_drain = true;
+
+int capture_buffers_needed(bool debug_view, bool recording)
+{
+    return CAPTURE_BUFFERS_PIPELINE + (debug_view ? DEBUG_VIEW_DEPTH + 1 : 0) +
+           (recording ? RECORDER_DEPTH : 0) + 1;
+}
+
+bool parse_capture_profile(const char* text, CaptureProfile& profile)
+{
+    CaptureProfile p;
+    p.fps = 0;
+    const char* rest = text;
+    int used = 0;
+    if (*rest != '@') {
+        if (sscanf(rest, "%dx%d%n", &p.width, &p.height, &used) != 2 || p.width <= 0 || p.height <= 0) {
+            return false;
+        }
+        rest += used;
+    } else {
+        p.width = p.height = 0;
+    }
+    if (*rest == '@') {
+        if (sscanf(rest + 1, "%d%n", &p.fps, &used) != 1 || p.fps <= 0) return false;
+        rest += 1 + used;
+    }
+    if (*rest == ':') {
+        if (strcmp(rest + 1, "YUYV") != 0) return false;
+        rest += 5;
+    }
+    if (*rest != '\0' || (p.width == 0 && p.fps == 0)) return false;
+    profile = p;
+    return true;
+}
+
+StagePeriods stage_periods(uint64_t frame_interval_ns)
+{
+    double t = frame_interval_ns ? double(frame_interval_ns) : 1e9 / CAPTURE_FPS_DEFAULT;
+    auto ms = [](double ns) { return std::max(1, int(std::lround(ns / 1e6))); };
+    StagePeriods p;
+    p.capture = ms(0.9 * t);
+    p.deadline = std::max(1, int(std::ceil(2 * t / 1e6)));
+    p.detect = ms(1.05 * t);
+    p.decide = ms(1.2 * t);
+    p.motors = ms(1.5 * t);
+    return p;
+}
+
+//the driver numbers every frame it captured, a jump means it had no free
+//buffer and dropped the frames in between. A smaller number is a restart
+//(stream on again, or a replay rewinding) and starts over.
+void Camera::_noteSequence(const FrameHandle& frame)
+{
+    uint32_t seq = frame.sequence();
+    if (_sequence_seen && seq > _last_sequence + 1) {
+        _stats.seq_gaps.fetch_add(1, std::memory_order_relaxed);
+        _stats.seq_lost.fetch_add(seq - _last_sequence - 1, std::memory_order_relaxed);
+    }
+    _sequence_seen = true;
+    _last_sequence = seq;
+}
+
+
+static double fps_of(const v4l2_fract& interval)
+{
+    return interval.numerator ? double(interval.denominator) / interval.numerator : 0;
+}
+
+struct CaptureMode {
+    uint32_t width, height;
+    v4l2_fract interval;        //0/0 if the driver does not list intervals
+};
+
+//the frame intervals `fd` offers at one size. Of a stepwise or continuous
+//range only the fastest end and, if it lies inside, 1/`fps` are kept.
+static void add_intervals(int fd, uint32_t fourcc, uint32_t width, uint32_t height, int fps,
+                          std::vector<CaptureMode>& modes)
+{
+    v4l2_frmivalenum iv = {};
+    iv.pixel_format = fourcc;
+    iv.width = width;
+    iv.height = height;
+    for (; ioctl(fd, VIDIOC_ENUM_FRAMEINTERVALS, &iv) == 0; ++iv.index) {
+        if (iv.type == V4L2_FRMIVAL_TYPE_DISCRETE) {
+            modes.push_back({width, height, iv.discrete});
+            continue;
+        }
+        modes.push_back({width, height, iv.stepwise.min});
+        v4l2_fract want{1, uint32_t(fps)};
+        if (fps > 0 && fps_of(want) <= fps_of(iv.stepwise.min) && fps_of(want) >= fps_of(iv.stepwise.max)) {
+            modes.push_back({width, height, want});
+        }
+        return;
+    }
+    if (iv.index == 0) modes.push_back({width, height, {0, 0}});
+}
+
+bool V4L2Source::_chooseMode(uint32_t& width, uint32_t& height, v4l2_fract& interval)
+{
+    v4l2_fmtdesc desc = {};
+    desc.type = V4L2_BUF_TYPE_VIDEO_CAPTURE;
+    bool offered = false;
+    for (; !offered && ioctl(cam.fd, VIDIOC_ENUM_FMT, &desc) == 0; ++desc.index) {
+        offered = desc.pixelformat == _profile.pixelformat;
+    }
+    if (!offered) {
+        syslog(LOG_ERR,"%s does not offer %.4s frames", _device, (const char*)&_profile.pixelformat);
+        return false;
+    }
+
+    //every (size, interval) pair the device lists; for a stepwise size
+    //range, the asked size snapped into it or else the largest
+    std::vector<CaptureMode> modes;
+    v4l2_frmsizeenum fs = {};
+    fs.pixel_format = _profile.pixelformat;
+    for (; ioctl(cam.fd, VIDIOC_ENUM_FRAMESIZES, &fs) == 0; ++fs.index) {
+        if (fs.type == V4L2_FRMSIZE_TYPE_DISCRETE) {
+            add_intervals(cam.fd, fs.pixel_format, fs.discrete.width, fs.discrete.height, _profile.fps, modes);
+            continue;
+        }
+        const v4l2_frmsize_stepwise& sw = fs.stepwise;
+        uint32_t w = _profile.width > 0 ? std::clamp(uint32_t(_profile.width), sw.min_width, sw.max_width) : sw.max_width;
+        uint32_t h = _profile.height > 0 ? std::clamp(uint32_t(_profile.height), sw.min_height, sw.max_height) : sw.max_height;
+        w -= (w - sw.min_width) % std::max(1u, sw.step_width);
+        h -= (h - sw.min_height) % std::max(1u, sw.step_height);
+        add_intervals(cam.fd, fs.pixel_format, w, h, _profile.fps, modes);
+        break;
+    }
+    for (const CaptureMode& m : modes) {
+        syslog(LOG_INFO,"%s offers %ux%u at %.2f fps", _device, m.width, m.height, fps_of(m.interval));
+    }
+    if (modes.empty()) {
+        //no size enumeration, ask for the profile and let S_FMT adjust
+        width = _profile.width > 0 ? _profile.width : FRAME_WIDTH;
+        height = _profile.height > 0 ? _profile.height : FRAME_HEIGHT;
+        interval = {1, uint32_t(_profile.fps)};
+        return true;
+    }
+
+    //the target rate first (29.97 counts as 30), then the asked size, then
+    //the most pixels and the rate closest above the target; if no mode
+    //reaches it, the fastest one, at the asked size if that is as fast
+    double target = _profile.fps * 0.99;
+    auto rank = [&](const CaptureMode& m) {
+        double fps = fps_of(m.interval);
+        bool meets = fps >= target;
+        bool sized = m.width == uint32_t(_profile.width) && m.height == uint32_t(_profile.height);
+        uint64_t area = uint64_t(m.width) * m.height;
+        return std::make_tuple(meets, meets && sized, meets ? area : 0, meets ? -fps : fps, sized, area);
+    };
+    const CaptureMode* best = &modes.front();
+    for (const CaptureMode& m : modes) {
+        if (rank(m) > rank(*best)) best = &m;
+    }
+    if (fps_of(best->interval) < target) {
+        syslog(LOG_WARNING,"%s reaches at most %.2f fps, asked for %d", _device, fps_of(best->interval), _profile.fps);
+    } else if (_profile.width > 0 && (best->width != uint32_t(_profile.width) || best->height != uint32_t(_profile.height))) {
+        syslog(LOG_INFO,"%s: %dx%d does not reach %d fps, taking %ux%u", _device, _profile.width,
+               _profile.height, _profile.fps, best->width, best->height);
+    }
+    width = best->width;
+    height = best->height;
+    interval = best->interval.numerator ? best->interval : v4l2_fract{1, uint32_t(_profile.fps)};
+    return true;
+}
+
+void V4L2Source::_negotiateInterval(const v4l2_fract* interval)
+{
+    v4l2_streamparm parm = {};
+    parm.type = V4L2_BUF_TYPE_VIDEO_CAPTURE;
+    if (ioctl(cam.fd, VIDIOC_G_PARM, &parm) == -1) {
+        syslog(LOG_INFO,"%s does not report its frame interval, assuming %d fps", _device, CAPTURE_FPS_DEFAULT);
+        _interval_ns = 0;
+        return;
+    }
+    if (interval && !(parm.parm.capture.capability & V4L2_CAP_TIMEPERFRAME)) {
+        syslog(LOG_WARNING,"%s cannot change its frame rate", _device);
+    } else if (interval) {
+        parm.parm.capture.timeperframe = *interval;
+        //S_PARM hands back the interval the driver settled on
+        if (ioctl(cam.fd, VIDIOC_S_PARM, &parm) == -1) {
+            syslog(LOG_WARNING,"%s: setting the frame interval failed: %s", _device, strerror(errno));
+            ioctl(cam.fd, VIDIOC_G_PARM, &parm);
+        }
+    }
+    const v4l2_fract& t = parm.parm.capture.timeperframe;
+    _interval_ns = t.denominator ? uint64_t(t.numerator) * 1000000000ull / t.denominator : 0;
+}
+
+int V4L2Source::open()
+{
+//open the device in a non blocking mode
+  const char* dev_name = _device;
+     cam.fd = ::open(dev_name, O_RDWR | O_NONBLOCK);
+    if (cam.fd == -1) {
+        syslog(LOG_ERR,"ERROR Opening video device");
+        return EXIT_FAILURE;
+    }
+    
+    //pick a mode only when a frame rate was asked for, otherwise the
+    //profile's size at the driver's rate
+    uint32_t width = _profile.width, height = _profile.height;
+    v4l2_fract interval = {};
+    if (_profile.fps > 0 && !_chooseMode(width, height, interval)) return EXIT_FAILURE;
+
+    //set format
+    cam.fmt.type = V4L2_BUF_TYPE_VIDEO_CAPTURE;
+    cam.fmt.fmt.pix.width = width;
+    cam.fmt.fmt.pix.height = height;
+    cam.fmt.fmt.pix.pixelformat = _profile.pixelformat;
+    cam.fmt.fmt.pix.field = V4L2_FIELD_NONE;
+    if (ioctl(cam.fd, VIDIOC_S_FMT, &cam.fmt) == -1) {
+        syslog(LOG_ERR,"ERROR Setting Pixel Format");
+         return EXIT_FAILURE;
+    }
+    //the driver adjusts what it cannot do; any size works, another format does not
+    if (cam.fmt.fmt.pix.pixelformat != _profile.pixelformat) {
+        syslog(LOG_ERR,"%s would not deliver %.4s frames", _device, (const char*)&_profile.pixelformat);
+        return EXIT_FAILURE;
+    }
+    if (cam.fmt.fmt.pix.width != width || cam.fmt.fmt.pix.height != height) {
+        syslog(LOG_WARNING,"%s: asked for %ux%u, got %ux%u", _device, width, height,
+               cam.fmt.fmt.pix.width, cam.fmt.fmt.pix.height);
+    }
+    _negotiateInterval(_profile.fps > 0 ? &interval : nullptr);
+    syslog(LOG_INFO,"%s: %ux%u at %.2f fps", _device, cam.fmt.fmt.pix.width, cam.fmt.fmt.pix.height,
+           _interval_ns ? 1e9 / _interval_ns : 0.0);
+    
+    //request for buffer to store our frames
+    v4l2_requestbuffers req = {};
+    req.count = _requested;
+    req.type = V4L2_BUF_TYPE_VIDEO_CAPTURE;
+    req.memory = V4L2_MEMORY_MMAP;
+    if (ioctl(cam.fd, VIDIOC_REQBUFS, &req) == -1) {
+        syslog(LOG_ERR,"ERROR Requesting Buffer");
+        return EXIT_FAILURE;
+    }
+    //the driver may grant more or fewer than asked
+    if (req.count < CAPTURE_BUFFERS_MIN) {
+        syslog(LOG_ERR,"driver granted %u buffers, need %d", req.count, CAPTURE_BUFFERS_MIN);
+        return EXIT_FAILURE;
+    }
+    if (int(req.count) != _requested) {
+        syslog(LOG_WARNING,"asked for %d buffers, driver granted %u", _requested, req.count);
+    }
+    cam.count = req.count;
+    cam.buffers.assign(cam.count, Buffer{});
+    cam.slots = std::make_unique<FrameSlot[]>(cam.count);
+    syslog(LOG_INFO,"%s: %d capture buffers of %u bytes", _device, cam.count, cam.fmt.fmt.pix.sizeimage);
+    
+    //query and queue buffers
+    for (int i = 0; i < cam.count; ++i) {
+        v4l2_buffer buf = {};
+        buf.type = V4L2_BUF_TYPE_VIDEO_CAPTURE;
+        buf.memory = V4L2_MEMORY_MMAP;
+        buf.index = i;
+
+        if (ioctl(cam.fd, VIDIOC_QUERYBUF, &buf) == -1) {
+            syslog(LOG_ERR,"Querying Buffer failed");
+            return EXIT_FAILURE;
+        }
+
+        cam.buffers[i].length = buf.length;
+        cam.buffers[i].start = mmap(NULL, buf.length, PROT_READ | PROT_WRITE, MAP_SHARED, cam.fd, buf.m.offset);
+        
+        if (cam.buffers[i].start == MAP_FAILED) {
+            syslog(LOG_ERR,"mmap failed");
+          return EXIT_FAILURE;
+        }
+
+        FrameSlot& slot = cam.slots[i];
+        slot.start = cam.buffers[i].start;
+        slot.length = cam.buffers[i].length;
+        slot.width = cam.fmt.fmt.pix.width;
+        slot.height = cam.fmt.fmt.pix.height;
+        slot.stride = cam.fmt.fmt.pix.bytesperline;
+        slot.source = this;
+        slot.coarse.reserve(slot.width, slot.height);
+
+        if (ioctl(cam.fd, VIDIOC_QBUF, &buf) == -1) {
+            syslog(LOG_ERR,"Queue Buffer failed");
+            return EXIT_FAILURE;
+        }
+    }
+    // Start streaming
+    int type = V4L2_BUF_TYPE_VIDEO_CAPTURE;
+    if (ioctl(cam.fd, VIDIOC_STREAMON, &type) == -1) {
+        syslog(LOG_ERR,"error starting streaming");
+         return EXIT_FAILURE;
+    }
+    return EXIT_SUCCESS;
+}	
+
+
+//give a slot back to the driver once the last consumer dropped it
+void V4L2Source::release(FrameSlot& slot)
+{
+    if (ioctl(cam.fd, VIDIOC_QBUF, &slot.buf) == -1) {
+        syslog(LOG_ERR,"error requeing buffer %u", slot.buf.index);
+    }
+}
+
+bool V4L2Source::grab(FrameHandle& frame)
+{
+    v4l2_buffer buf = {};
+    buf.type = V4L2_BUF_TYPE_VIDEO_CAPTURE;
+    buf.memory = V4L2_MEMORY_MMAP;
+
+    if (ioctl(cam.fd, VIDIOC_DQBUF, &buf) == -1) {
+        if (errno == EAGAIN) return false;
+        //capture reports it, rate limited
+        snprintf(_error, sizeof(_error), "%s: VIDIOC_DQBUF failed: %s", _device, strerror(errno));
+        return false;
+    }
+    _error[0] = '\0';
+
+    cam.slots[buf.index].buf = buf;
+    //the driver stamps the end of the frame on the clock steady_clock reads
+    cam.slots[buf.index].ready_ns =
+        (buf.flags & V4L2_BUF_FLAG_TIMESTAMP_MASK) == V4L2_BUF_FLAG_TIMESTAMP_MONOTONIC
+            ? uint64_t(buf.timestamp.tv_sec) * 1000000000ull + uint64_t(buf.timestamp.tv_usec) * 1000
+            : 0;
+    frame = FrameHandle(&cam.slots[buf.index]);
+    return true;
+}
+
+//the driver flags the fd readable once a buffer is on its done queue
+bool V4L2Source::wait(int timeout_ms)
+{
+    //with no buffer queued poll() reports an error at once, it does not wait
+    _error[0] = '\0';
+    timeout_ms = waitForRelease(timeout_ms);
+    if (timeout_ms < 0) return false;
+    struct pollfd pfd{cam.fd, POLLIN, 0};
+    int ready = poll(&pfd, 1, timeout_ms);
+    //these come back at once, every time: an unplugged or failing device
+    //would otherwise look like a camera that is merely late
+    if (ready < 0 && errno != EINTR) {
+        snprintf(_error, sizeof(_error), "%s: poll failed: %s", _device, strerror(errno));
+    } else if (ready > 0 && (pfd.revents & (POLLERR | POLLHUP | POLLNVAL))) {
+        snprintf(_error, sizeof(_error), "%s: %s", _device,
+                 pfd.revents & POLLNVAL ? "not open" :
+                 pfd.revents & POLLHUP ? "device gone" : "device error");
+    }
+    return ready > 0 && !_error[0] && (pfd.revents & POLLIN);
+}
+
+FrameFormat V4L2Source::format() const
+{
+    FrameFormat f;
+    f.pixelformat = cam.fmt.fmt.pix.pixelformat;
+    f.width = cam.fmt.fmt.pix.width;
+    f.height = cam.fmt.fmt.pix.height;
+    f.stride = cam.fmt.fmt.pix.bytesperline;
+    f.frame_bytes = cam.fmt.fmt.pix.sizeimage;
+    f.frame_interval_ns = _interval_ns;
+    return f;
+}
+
+V4L2Source::~V4L2Source()
+{
+    if (cam.fd == -1) return;
+    int type = V4L2_BUF_TYPE_VIDEO_CAPTURE;
+    ioctl(cam.fd, VIDIOC_STREAMOFF, &type);
+    for (int i = 0; i < cam.count; ++i) {
+        if (cam.buffers[i].start && cam.buffers[i].start != MAP_FAILED) {
+            munmap(cam.buffers[i].start, cam.buffers[i].length);
+        }
+    }
+    close(cam.fd);
+}
+
+
+int Camera::open(std::unique_ptr<FrameSource> source, FrameChannel& frames)
+{
+    //a frame still waiting for the detector belongs to the old source
+    frames.reset();
+    _source = std::move(source);
+    _sequence_seen = false;
+    if (_source->open() != EXIT_SUCCESS) {
+        syslog(LOG_ERR,"camera %d: frame source %s failed to open", _index, _source->name());
+        return EXIT_FAILURE;
+    }
+    //everything downstream is timed off the interval the source settled on
+    _periods = stage_periods(_source->format().frame_interval_ns);
+    syslog(LOG_INFO,"camera %d: frame source %s streaming, capture deadline %d ms", _index,
+           _source->name(), _periods.deadline);
+    return EXIT_SUCCESS;
+}
+
+FrameFormat Camera::format() const
+{
+    return _source ? _source->format() : FrameFormat{};
+}
+
+bool Camera::finished() const
+{
+    return _source && _source->finished();
+}
+
+
+void Camera::capture(FrameChannel& frames, bool pool) {
+        //on frame, sleep in poll() until the driver has one; the deadline
+        //bounds how long a stalled camera or a stop request takes to notice
+        uint64_t started_ns = steady_ns();
+        bool timed_out = capture_wake == CAPTURE_ON_FRAME && _source &&
+                         !_source->wait(_periods.deadline);
+        uint64_t woke_ns = steady_ns();
+        _stats.wakeups.fetch_add(1, std::memory_order_relaxed);
+
+        //taken every wakeup, frame or not, so old snapshots can be freed
+        const ConfigSnapshot* snapshot = config_store.acquire(camera_reader(CONFIG_READER_CAPTURE, _index));
+
+        //hand the buffer over by handle, it goes back to the source when the
+        //last consumer lets go of it (possibly right here if the detector
+        //never picked up the previous frame)
+        FrameHandle frame;
+        if (!_source || !_source->grab(frame)) {
+            const char* error = _source ? _source->error() : nullptr;
+            if (error) {
+                _noteError(error);
+            } else {
+                (_source && _source->starved() ? _stats.starved : timed_out ? _stats.deadline : _stats.idle)
+                    .fetch_add(1, std::memory_order_relaxed);
+            }
+            _stats.work_ns.fetch_add(steady_ns() - woke_ns, std::memory_order_relaxed);
+            //a failing device answers at once; free running, the sequencer
+            //would release capture again straight away and spin at top
+            //priority, so sit out the deadline as a periodic release would
+            if (error && capture_wake == CAPTURE_ON_FRAME) {
+                uint64_t until_ns = started_ns + uint64_t(_periods.deadline) * 1000000;
+                uint64_t now_ns = steady_ns();
+                if (now_ns < until_ns) std::this_thread::sleep_for(std::chrono::nanoseconds(until_ns - now_ns));
+            }
+            return;
+        }
+
+        _noteSequence(frame);
+
+        //frames queued behind this one are newer: with drain, hand each
+        //older one straight back to the driver and keep only the last. No
+        //more than the source's buffers can be queued, and a source that
+        //makes frames on demand has none waiting to skip.
+        int queue = _source->buffers();
+        if (capture_drain) {
+            int behind = 0;
+            FrameHandle newer;
+            while (behind < queue && _source->wait(0) && _source->grab(newer)) {
+                _noteSequence(newer);
+                //a recording still gets every frame
+                if (_recorder && _recorder->active()) _recorder->submit(frame);
+                frame = std::move(newer);
+                ++behind;
+            }
+            if (behind) {
+                _stats.missed.fetch_add(1, std::memory_order_relaxed);
+                _stats.drained.fetch_add(behind, std::memory_order_relaxed);
+            }
+        } else if (queue && _source->wait(0)) {
+            _stats.missed.fetch_add(1, std::memory_order_relaxed);
+        }
+
+        frame_copy_stats.frames_captured.fetch_add(1, std::memory_order_relaxed);
+        _stats.frames.fetch_add(1, std::memory_order_relaxed);
+        //our own clock: replayed V4L2 timestamps come from the recording
+        uint64_t dequeued_ns = steady_ns();
+        frame.stamp_capture(dequeued_ns);
+
+        //how long the frame sat in the driver before we had it
+        if (frame.ready_ns() && frame.ready_ns() < dequeued_ns) {
+            uint64_t age = dequeued_ns - frame.ready_ns();
+            _stats.aged.fetch_add(1, std::memory_order_relaxed);
+            _stats.age_ns.fetch_add(age, std::memory_order_relaxed);
+            if (age > _stats.age_max_ns.load(std::memory_order_relaxed)) {
+                _stats.age_max_ns.store(age, std::memory_order_relaxed);
+            }
+        }
+
+        //tile signature for the detector's change gate, while the frame is
+        //still hot in cache and not shared with anyone
+        if (change_threshold > 0) {
+            auto t0 = std::chrono::steady_clock::now();
+            compute_frame_signature(frame.data(), frame.width(), frame.height(), frame.stride(),
+                                    frame.signature());
+            change_gate_stats.signature_ns.fetch_add(
+                std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - t0).count(),
+                std::memory_order_relaxed);
+        }
+
+        //sampled class mask for coarse-to-fine acquisition, the detector
+        //ignores it if the table changes before it gets the frame
+        const ColourLut* lut = snapshot && pyramid_level > 1 && detect_path == DETECT_LUT &&
+                               pool ? &snapshot->lut : nullptr;
+        if (lut) {
+            auto t0 = std::chrono::steady_clock::now();
+            pool_mask_from_lut(frame.data(), frame.width(), frame.height(), frame.stride(),
+                               pyramid_level, *lut, frame.coarse());
+            pyramid_stats.pool_ns.fetch_add(
+                std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - t0).count(),
+                std::memory_order_relaxed);
+        } else {
+            frame.coarse().valid = false;
+        }
+
+        //recording is a pointer hand-off, the writer thread does the copy
+        if (_recorder && _recorder->active()) _recorder->submit(frame);
+
+        frame.stamp_published(steady_ns());
+        frames.publish(frame);
+        service1_ok = true;
+        //syslog(LOG_INFO, "Service 1 OK set");
+        _stats.work_ns.fetch_add(steady_ns() - woke_ns, std::memory_order_relaxed);
+}
+
+void Camera::_noteError(const char* error)
+{
+    uint64_t errors = _stats.errors.fetch_add(1, std::memory_order_relaxed) + 1;
+    uint64_t now_ns = steady_ns();
+    if (_error_logged_ns && now_ns - _error_logged_ns < uint64_t(CAPTURE_ERROR_LOG_MS) * 1000000) return;
+    _error_logged_ns = now_ns;
+    syslog(LOG_ERR, "camera %d: %s (%llu capture errors so far)", _index, error, (unsigned long long)errors);
+}
+
+void Camera::logStats() const
+{
+    uint64_t wakeups = _stats.wakeups.load();
+    if (wakeups == 0) return;
+    uint64_t frames = _stats.frames.load();
+    uint64_t aged = _stats.aged.load();
+    if (capture_wake == CAPTURE_ON_FRAME) {
+        syslog(LOG_INFO, "Capture Wake Stats (camera %d, on frame, %d ms deadline):", _index, _periods.deadline);
+    } else {
+        syslog(LOG_INFO, "Capture Wake Stats (camera %d, every %d ms):", _index, _periods.capture);
+    }
+    syslog(LOG_INFO, "  Wakeups / frames      : %llu / %llu (%.2f per frame)",
+           (unsigned long long)wakeups, (unsigned long long)frames,
+           frames ? double(wakeups) / frames : 0.0);
+    syslog(LOG_INFO, "  Idle / missed wakeups : %llu / %llu, %llu deadline misses",
+           (unsigned long long)_stats.idle.load(),
+           (unsigned long long)_stats.missed.load(),
+           (unsigned long long)_stats.deadline.load());
+    syslog(LOG_INFO, "  Buffers all held      : %llu wakeups without a free one",
+           (unsigned long long)_stats.starved.load());
+    syslog(LOG_INFO, "  Source errors         : %llu wakeups backed off",
+           (unsigned long long)_stats.errors.load());
+    syslog(LOG_INFO, "  Drained / dropped     : %llu requeued for a newer frame%s, %llu lost by the driver in %llu gaps",
+           (unsigned long long)_stats.drained.load(), capture_drain ? "" : " (drain off)",
+           (unsigned long long)_stats.seq_lost.load(),
+           (unsigned long long)_stats.seq_gaps.load());
+    if (aged) {
+        syslog(LOG_INFO, "  Frame age at dequeue  : %.2f ms mean, %.2f ms max",
+               _stats.age_ns.load() / 1e6 / aged,
+               _stats.age_max_ns.load() / 1e6);
+    }
+    syslog(LOG_INFO, "  Awake time            : %.1f ms (%.1f us per wakeup)",
+           _stats.work_ns.load() / 1e6, _stats.work_ns.load() / 1e3 / wakeups);
+}
@@ -1,41 +1,202 @@
-#pragma once
-#include <linux/videodev2.h>
-#include <opencv2/opencv.hpp>
-#include <sys/ioctl.h>
-#include <sys/mman.h>
-#include <mutex>
-#include <fstream>
-#include <fcntl.h>
-#include <unistd.h>
-#include <syslog.h>
-#define FRAME_WIDTH 640
-#define FRAME_HEIGHT 480
-#define CAM_DEVICE "/dev/video0"
-#define NBUF 4
-
-
-struct Buffer {
-    void* start;
-    size_t length;
-};
-//a structure to hold buffers and file descriptor of camera
-typedef struct CameraContext{
-	int fd=-1;
-	Buffer buffers[NBUF];
-    v4l2_format fmt{};
-
-}CameraContext;
-
-
-extern cv::Mat latest_frame;
-extern std::mutex frame_mutex;
-extern CameraContext cam;
-
-/*
- * initialze camera*
- * refrence https://www.marcusfolkesson.se/blog/capture-a-picture-with-v4l2/
- */ 
-int init_camera();
-
-//service implementation for camera capture
-void camera_capture_service();
+#pragma once
+#include <linux/videodev2.h>
+#include <opencv2/opencv.hpp>
+#include <sys/ioctl.h>
+#include <sys/mman.h>
+#include <mutex>
+#include <fstream>
+#include <fcntl.h>
+#include <unistd.h>
+#include <syslog.h>
+#include <memory>
+#include <vector>
+#include <atomic>
+#include <cstdint>
+#include "frame_ring.hpp"
+#include "frame_source.hpp"
+#include "pipeline.hpp"
+#define FRAME_WIDTH 640
+#define FRAME_HEIGHT 480
+#define CAM_DEVICE "/dev/video0"
+//buffers queued to the driver (-B): each one is another frame that can
+//wait in the queue, but every consumer holding a frame takes one away.
+//The pipeline holds up to three at once: the frame capture just dequeued,
+//the one waiting in the frame channel and the one the detector works on.
+//The debug view (-V) adds its queue and the frame it renders, the
+//recorder (-R) its queue. One more has to stay with the driver to be
+//filled; capture_buffers_needed() adds it all up.
+#define CAPTURE_BUFFERS_PIPELINE 3
+#define CAPTURE_BUFFERS_DEFAULT 4
+#define CAPTURE_BUFFERS_MIN 2
+#define CAPTURE_BUFFERS_MAX 32
+//fewest buffers that leave one with the driver while every consumer
+//holds its share
+int capture_buffers_needed(bool debug_view, bool recording);
+
+//a failing device is reported at most this often
+#define CAPTURE_ERROR_LOG_MS 5000
+
+//frame rate assumed when a source does not report its frame interval
+#define CAPTURE_FPS_DEFAULT 30
+
+//what -M asks of a capture device. fps 0 keeps the driver's frame rate
+//(no VIDIOC_S_PARM), a size of 0x0 takes the largest one reaching fps.
+//Detection only reads YUYV.
+struct CaptureProfile {
+    int width = FRAME_WIDTH;
+    int height = FRAME_HEIGHT;
+    int fps = 0;
+    uint32_t pixelformat = V4L2_PIX_FMT_YUYV;
+};
+
+//"WxH", "WxH@FPS" or "@FPS", optionally followed by ":YUYV"; false if
+//malformed or not a format the detector reads
+bool parse_capture_profile(const char* text, CaptureProfile& profile);
+
+//sequencer periods of the stages fed by a camera with frame interval T,
+//chosen so that 30 fps gives the original hand-tuned values
+struct StagePeriods {
+    int capture;        //0.9 T, periodic capture release (30 ms)
+    int deadline;       //2 T rounded up, on frame: no frame this long is a miss (67 ms)
+    int detect;         //1.05 T (35 ms)
+    int decide;         //1.2 T (40 ms)
+    int motors;         //1.5 T (50 ms)
+};
+StagePeriods stage_periods(uint64_t frame_interval_ns);
+
+//how the capture service is woken
+enum CaptureWake {
+    CAPTURE_PERIODIC,   //released every StagePeriods::capture, grabs whatever is ready
+    CAPTURE_ON_FRAME    //free-running, blocks in poll() until a frame lands
+};
+extern CaptureWake capture_wake;
+
+//drain every ready buffer on each wakeup and keep only the newest (the
+//default), or take one per wakeup in queue order
+extern bool capture_drain;
+
+//what each capture wakeup found
+struct CaptureWakeStats {
+    std::atomic<uint64_t> wakeups{0};
+    std::atomic<uint64_t> frames{0};       //handed to the detector
+    std::atomic<uint64_t> idle{0};         //no frame ready
+    std::atomic<uint64_t> missed{0};       //a newer frame was already waiting behind the one taken
+    std::atomic<uint64_t> drained{0};      //older frames requeued unprocessed to keep the newest
+    std::atomic<uint64_t> seq_gaps{0};     //jumps in v4l2_buffer.sequence
+    std::atomic<uint64_t> seq_lost{0};     //frames the driver dropped in those jumps
+    std::atomic<uint64_t> deadline{0};     //on frame: nothing within StagePeriods::deadline
+    std::atomic<uint64_t> starved{0};      //no frame: consumers held every buffer
+    std::atomic<uint64_t> errors{0};       //no frame: the source failed, capture backed off
+    std::atomic<uint64_t> aged{0};         //frames with a known ready time
+    std::atomic<uint64_t> age_ns{0};       //ready to dequeued, summed
+    std::atomic<uint64_t> age_max_ns{0};
+    std::atomic<uint64_t> work_ns{0};      //awake time, the wait itself excluded
+};
+
+struct Buffer {
+    void* start = nullptr;
+    size_t length = 0;
+};
+//a structure to hold buffers and file descriptor of camera
+typedef struct CameraContext{
+	int fd=-1;
+	int count=0;                //buffers the driver granted
+	std::vector<Buffer> buffers;
+    std::unique_ptr<FrameSlot[]> slots;     //ref counted views of buffers, handed to consumers
+    v4l2_format fmt{};
+
+}CameraContext;
+
+//frame source backed by a V4L2 capture device streaming into mmap buffers
+class V4L2Source : public FrameSource {
+public:
+    explicit V4L2Source(const char* device = CAM_DEVICE, int buffers = CAPTURE_BUFFERS_DEFAULT,
+                        const CaptureProfile& profile = CaptureProfile{})
+        : _device(device), _requested(buffers), _profile(profile) {}
+    ~V4L2Source() override;
+
+    /*
+     * initialze camera*
+     * refrence https://www.marcusfolkesson.se/blog/capture-a-picture-with-v4l2/
+     */
+    int open() override;
+    bool grab(FrameHandle& frame) override;
+    bool wait(int timeout_ms) override;
+    void release(FrameSlot& slot) override;
+    const char* name() const override { return _device; }
+    FrameFormat format() const override;
+    int buffers() const override { return cam.count; }
+    bool starved() const override { return all_slots_held(cam.slots.get(), cam.count); }
+    const char* error() const override { return _error[0] ? _error : nullptr; }
+
+private:
+    //pick the size and frame interval to ask for from the modes the
+    //device lists, false if it offers none in the profile's format
+    bool _chooseMode(uint32_t& width, uint32_t& height, v4l2_fract& interval);
+    //set the frame interval if asked to, then read back the one in effect
+    void _negotiateInterval(const v4l2_fract* interval);
+
+    const char* _device;
+    int _requested;
+    CaptureProfile _profile;
+    CameraContext cam;
+    uint64_t _interval_ns = 0;      //0: the driver did not say
+    char _error[96] = "";           //see error(), capture thread only
+};
+
+
+class FrameRecorder;
+
+//one capture device or recording and the capture service feeding its
+//frames on. Every camera runs its own capture -> detect chain
+//(laser_pipeline.hpp) with its own sequence tracking and stats.
+class Camera {
+public:
+    explicit Camera(int index = 0) : _index(index) {}
+
+    //install the frame source feeding capture() and start it; a frame of
+    //the old source still waiting in `frames` is dropped
+    int open(std::unique_ptr<FrameSource> source, FrameChannel& frames);
+
+    //also submit every captured frame to `recorder`
+    void record(FrameRecorder* recorder) { _recorder = recorder; }
+
+    int index() const { return _index; }
+    const char* name() const { return _source ? _source->name() : "none"; }
+
+    //geometry of the frames produced by the installed source
+    FrameFormat format() const;
+
+    //stage periods for the installed source's frame interval, or for
+    //CAPTURE_FPS_DEFAULT if it has none
+    const StagePeriods& periods() const { return _periods; }
+
+    //true once a finite source (a replayed recording) has run out of frames
+    bool finished() const;
+
+    //service implementation for camera capture: the newest dequeued frame
+    //goes to `frames`, consumers take a handle instead of a copy. With
+    //`pool` the class mask is sampled for a coarse-to-fine scan.
+    void capture(FrameChannel& frames, bool pool);
+
+    const CaptureWakeStats& stats() const { return _stats; }
+
+    //log wakeups per frame, idle and missed wakeups, drained and dropped
+    //frames, frame age and CPU time
+    void logStats() const;
+
+private:
+    void _noteSequence(const FrameHandle& frame);
+    //count a source error, logging it every CAPTURE_ERROR_LOG_MS at most
+    void _noteError(const char* error);
+
+    int _index;
+    //the source must outlive the frame channel, which releases its slot on destruction
+    std::unique_ptr<FrameSource> _source;
+    FrameRecorder* _recorder = nullptr;
+    StagePeriods _periods = stage_periods(0);
+    bool _sequence_seen = false;
+    uint32_t _last_sequence = 0;
+    uint64_t _error_logged_ns = 0;
+    CaptureWakeStats _stats;
+};
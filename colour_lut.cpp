@@ -0,0 +1,80 @@
+/***************************************************************
+ * File: colour_lut.cpp
+ * Description: Colour lookup table construction and the per-pixel
+ *              lookup pass.
+ ***************************************************************/
+
+#include "colour_lut.hpp"
+#include "laser_mask.hpp"
+
+void build_colour_lut(const HSVConfig& cfg, ColourLut& lut)
+{
+    MaskThresholds t = compile_thresholds(cfg);
+    MaskRowKernel kernel = mask_kernel(selected_mask_kernel());
+
+    // one synthetic YUYV row per (U, V) cell pair covering every Y cell,
+    // sampled at the cell centres
+    const int half = 1 << (7 - LUT_BITS);
+    uint8_t row[LUT_SIDE * 2];
+    uint8_t out[LUT_SIDE];
+    for (int v = 0; v < LUT_SIDE; ++v) {
+        for (int u = 0; u < LUT_SIDE; ++u) {
+            for (int y = 0; y < LUT_SIDE; y += 2) {
+                row[y * 2 + 0] = uint8_t((y << (8 - LUT_BITS)) + half);
+                row[y * 2 + 1] = uint8_t((u << (8 - LUT_BITS)) + half);
+                row[y * 2 + 2] = uint8_t(((y + 1) << (8 - LUT_BITS)) + half);
+                row[y * 2 + 3] = uint8_t((v << (8 - LUT_BITS)) + half);
+            }
+            kernel(row, LUT_SIDE, out, t);
+
+            uint8_t* cell = lut.cls + ((v << (2 * LUT_BITS)) | (u << LUT_BITS));
+            for (int y = 0; y < LUT_SIDE; ++y) cell[y] = out[y];
+        }
+    }
+}
+
+void mask_from_lut(const uint8_t* yuyv, int width, int height, int stride,
+                   const ColourLut& lut, cv::Mat& mask)
+{
+    mask.create(height, width, CV_8UC1);
+    const int shift = 8 - LUT_BITS;
+    for (int r = 0; r < height; ++r) {
+        const uint8_t* p = yuyv + size_t(r) * stride;
+        uint8_t* m = mask.ptr<uint8_t>(r);
+        for (int x = 0; x + 1 < width; x += 2, p += 4) {
+            // both pixels of a macropixel share U and V
+            const uint8_t* uv = lut.cls + (((p[3] >> shift) << (2 * LUT_BITS)) |
+                                           ((p[1] >> shift) << LUT_BITS));
+            m[x]     = uv[p[0] >> shift];
+            m[x + 1] = uv[p[2] >> shift];
+        }
+    }
+}
+
+// One row into its row of blocks, L pixels (L / 2 macropixels) per block
+void pool_mask_from_lut(const uint8_t* yuyv, int width, int height, int stride, int level,
+                        const ColourLut& lut, CoarseMask& coarse)
+{
+    const int shift = 8 - LUT_BITS;
+    coarse.level = level;
+    coarse.width = (width + level - 1) / level;
+    coarse.height = (height + level - 1) / level;
+    coarse.lut_generation = lut.generation;
+    coarse.bits.resize(size_t(coarse.width) * coarse.height);  // within the room reserved at open
+
+    // one macropixel per block: every level-th row, every level-th pixel pair
+    for (int by = 0; by < coarse.height; ++by) {
+        const uint8_t* p = yuyv + size_t(by) * level * stride;
+        uint8_t* out = coarse.bits.data() + size_t(by) * coarse.width;
+        for (int bx = 0; bx < coarse.width; ++bx, p += 2 * level) {
+            if (bx * level + 1 >= width) {
+                out[bx] = 0;
+                continue;
+            }
+            const uint8_t* uv = lut.cls + (((p[3] >> shift) << (2 * LUT_BITS)) |
+                                           ((p[1] >> shift) << LUT_BITS));
+            out[bx] = uv[p[0] >> shift] | uv[p[2] >> shift];
+        }
+    }
+    coarse.valid = true;
+}
@@ -0,0 +1,53 @@
+/***************************************************************
+ * File: colour_lut.hpp
+ * Description: Quantized YUV -> class lookup table for the laser
+ *              mask. The thresholds only change when Config.json is
+ *              reloaded, so instead of converting and thresholding
+ *              every pixel the detector looks its class up in a
+ *              32x32x32 table (5 bits per Y/U/V channel, one byte per
+ *              cell, 32 KB, fits in L1/L2).
+ *
+ *              Each cell is classified once, at its centre, by the same
+ *              fused kernel the YUYV path uses, so every class and every
+ *              range (red's two hue ranges) is baked into the table and
+ *              costs nothing per pixel. Pixels within half a cell
+ *              (4 levels) of a threshold can land on either side;
+ *              detect_bench reports the mismatch rate.
+ *
+ *              Every config snapshot carries its own table, built by
+ *              the config service when Config.json is reloaded, see
+ *              config_snapshot.hpp.
+ ***************************************************************/
+
+#pragma once
+
+#include <cstdint>
+#include <opencv2/opencv.hpp>
+#include "red_laser_service.hpp"
+
+#define LUT_BITS  5
+#define LUT_SIDE  (1 << LUT_BITS)
+#define LUT_CELLS (LUT_SIDE * LUT_SIDE * LUT_SIDE)
+
+struct ColourLut {
+    uint8_t cls[LUT_CELLS];     // class bits, index: V << 10 | U << 5 | Y (top LUT_BITS of each)
+    uint64_t generation;        // of the config snapshot it belongs to
+
+    static int index(int y, int u, int v)
+    {
+        return ((v >> (8 - LUT_BITS)) << (2 * LUT_BITS)) |
+               ((u >> (8 - LUT_BITS)) << LUT_BITS) | (y >> (8 - LUT_BITS));
+    }
+};
+
+// Classify every cell for `cfg`
+void build_colour_lut(const HSVConfig& cfg, ColourLut& lut);
+
+// Whole frame from packed YUYV via the table, mask is (re)allocated as CV_8UC1
+void mask_from_lut(const uint8_t* yuyv, int width, int height, int stride,
+                   const ColourLut& lut, cv::Mat& mask);
+
+// Whole frame via the table, one macropixel per level x level block (level
+// 2 or 4): 1/4 or 1/16 of the lookups of mask_from_lut()
+void pool_mask_from_lut(const uint8_t* yuyv, int width, int height, int stride, int level,
+                        const ColourLut& lut, CoarseMask& coarse);
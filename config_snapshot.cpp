@@ -0,0 +1,87 @@
+/***************************************************************
+ * File: config_snapshot.cpp
+ * Description: Config snapshot building, publishing and reclamation.
+ ***************************************************************/
+
+#include "config_snapshot.hpp"
+
+#include <chrono>
+#include <ctime>
+#include <syslog.h>
+
+ConfigStore config_store;
+
+void ConfigStore::publish(const HSVConfig& hsv, const DecisionMap& decision, uint64_t written_ns)
+{
+    auto t0 = std::chrono::steady_clock::now();
+
+    auto snapshot = std::make_unique<ConfigSnapshot>();
+    snapshot->generation = _published + 1;
+    snapshot->hsv = hsv;
+    snapshot->thresholds = compile_thresholds(hsv);
+    build_colour_lut(hsv, snapshot->lut);
+    snapshot->lut.generation = snapshot->generation;
+    snapshot->decision = decision;
+    snapshot->written_ns = written_ns;
+
+    _current.store(snapshot.get(), std::memory_order_release);
+    if (_live) _retired.push_back(std::move(_live));
+    _live = std::move(snapshot);
+    ++_published;
+
+    double ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - t0).count();
+    _last_build_ms = ms;
+    if (ms > _max_build_ms) _max_build_ms = ms;
+    syslog(LOG_INFO, "Config: generation %llu built in %.3f ms",
+           (unsigned long long)_live->generation, ms);
+
+    reclaim();
+}
+
+void ConfigStore::reclaim()
+{
+    if (_retired.empty()) return;
+
+    // a reader that announced generation g can only hold g or newer
+    uint64_t oldest = UINT64_MAX;
+    for (const Held& held : _held) {
+        uint64_t g = held.generation.load(std::memory_order_acquire);
+        if (g < oldest) oldest = g;
+    }
+    size_t kept = 0;
+    for (auto& snapshot : _retired) {
+        if (snapshot->generation < oldest) {
+            snapshot.reset();
+            ++_reclaimed;
+        } else {
+            _retired[kept++] = std::move(snapshot);
+        }
+    }
+    _retired.resize(kept);
+}
+
+void ConfigStore::noteFirstFrame(const ConfigSnapshot& snapshot)
+{
+    if (!snapshot.written_ns) return;
+    struct timespec now;
+    clock_gettime(CLOCK_REALTIME, &now);
+    uint64_t now_ns = uint64_t(now.tv_sec) * 1000000000ull + now.tv_nsec;
+    // mtime and now are both wall clock, a clock step can put mtime ahead
+    uint64_t ns = now_ns > snapshot.written_ns ? now_ns - snapshot.written_ns : 0;
+    _applied.fetch_add(1, std::memory_order_relaxed);
+    _last_apply_ns.store(ns, std::memory_order_relaxed);
+    if (ns > _max_apply_ns.load(std::memory_order_relaxed)) _max_apply_ns.store(ns, std::memory_order_relaxed);
+}
+
+void ConfigStore::logStats() const
+{
+    syslog(LOG_INFO, "Config Snapshot Stats:");
+    syslog(LOG_INFO, "  Published / reclaimed : %llu / %llu, %zu awaiting readers",
+           (unsigned long long)_published, (unsigned long long)_reclaimed, _retired.size());
+    syslog(LOG_INFO, "  Last / max build time : %.3f / %.3f ms", _last_build_ms, _max_build_ms);
+    if (_applied.load() > 0) {
+        syslog(LOG_INFO, "  Write -> first frame  : %.3f ms last, %.3f ms max over %llu reloads",
+               _last_apply_ns.load() / 1e6, _max_apply_ns.load() / 1e6,
+               (unsigned long long)_applied.load());
+    }
+}
@@ -0,0 +1,127 @@
+/***************************************************************
+ * File: config_snapshot.hpp
+ * Description: Immutable config snapshots. A reload builds everything
+ *              the pipeline derives from Config.json: the thresholds
+ *              compiled for the YUYV kernels, the colour lookup table
+ *              and the direction decision map. It then publishes the
+ *              whole snapshot with one atomic pointer store. The RT
+ *              services never copy the config, take a lock or recompute
+ *              anything when it changes; picking up a reload is the same
+ *              atomic load as every other frame.
+ *
+ *              Old snapshots are freed by the publisher, off the RT
+ *              cores, once every reader has moved past them (quiescent
+ *              state based reclamation). Each reader announces the
+ *              generation it holds when it acquires a snapshot. A
+ *              retired snapshot is freed when every announced generation
+ *              is newer than it.
+ ***************************************************************/
+
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <vector>
+#include "colour_lut.hpp"
+#include "laser_mask.hpp"
+#include "frame_source.hpp"
+
+// The services that read snapshots. A reader that has never acquired one
+// holds back reclamation, so only services that run every period are here,
+// and the slots of cameras that are not running are retired at start-up.
+// Every camera has a capture and a detect reader, see camera_reader().
+enum ConfigReader {
+    CONFIG_READER_DECIDE,
+    CONFIG_READER_CAPTURE,      // pools the mask with the table
+    CONFIG_READER_DETECT,       // also covers its stripe helpers
+    CONFIG_READERS = CONFIG_READER_CAPTURE + 2 * MAX_CAMERAS
+};
+
+// `reader` (capture or detect) of camera `camera`
+inline ConfigReader camera_reader(ConfigReader reader, int camera)
+{
+    return ConfigReader(reader + 2 * camera);
+}
+
+// Bands of the frame that decide direction and speed; the defaults are
+// the original ones for 640x480
+struct DecisionMap {
+    float left_x = 200;         // left of this: turn left
+    float right_x = 450;        // right of this: turn right
+    float bottom_y = 480;       // forward only up to this row
+    float horizon_y = 400;      // turning needs the dot off this row
+    float fast_y = 160;         // above this row: speed 3
+    float medium_y = 320;       // up to this row: speed 2, below: 1
+};
+
+struct ConfigSnapshot {
+    uint64_t generation;        // 1 for the first snapshot, then +1 per publish
+    HSVConfig hsv;
+    MaskThresholds thresholds;  // hsv compiled for mask_from_yuyv()
+    ColourLut lut;              // lut.generation == generation
+    DecisionMap decision;
+    uint64_t written_ns;        // CLOCK_REALTIME mtime of the file it came from, 0 for built-in defaults
+};
+
+class ConfigStore {
+public:
+    // Build a snapshot and make it current, then reclaim. One publisher at
+    // a time: the config service, or main/the bench before the services run.
+    void publish(const HSVConfig& hsv, const DecisionMap& decision = DecisionMap{},
+                 uint64_t written_ns = 0);
+
+    // Current snapshot, nullptr before the first publish. Also tells the
+    // store that `reader` is done with the one it acquired before, so it
+    // stays valid until the reader's next acquire().
+    const ConfigSnapshot* acquire(ConfigReader reader)
+    {
+        const ConfigSnapshot* snapshot = _current.load(std::memory_order_acquire);
+        if (snapshot) _held[reader].generation.store(snapshot->generation, std::memory_order_release);
+        return snapshot;
+    }
+
+    // `reader` will never acquire, stop holding reclamation back for it.
+    // Before the services start only.
+    void retire(ConfigReader reader)
+    {
+        _held[reader].generation.store(UINT64_MAX, std::memory_order_release);
+    }
+
+    // Current snapshot for the publishing thread, which is the only one
+    // that frees them
+    const ConfigSnapshot* current() const { return _current.load(std::memory_order_acquire); }
+
+    // Free retired snapshots every reader has moved past; publisher only
+    void reclaim();
+
+    // Detector: first frame processed under `snapshot`, closes its
+    // file-write-to-first-frame latency
+    void noteFirstFrame(const ConfigSnapshot& snapshot);
+
+    void logStats() const;
+
+private:
+    std::atomic<const ConfigSnapshot*> _current{nullptr};
+
+    // one line per reader, they announce every frame
+    struct alignas(64) Held {
+        std::atomic<uint64_t> generation{0};
+    };
+    Held _held[CONFIG_READERS];
+
+    // publisher side
+    std::unique_ptr<ConfigSnapshot> _live;
+    std::vector<std::unique_ptr<ConfigSnapshot>> _retired;
+    uint64_t _published = 0;
+    uint64_t _reclaimed = 0;
+    double _last_build_ms = 0;
+    double _max_build_ms = 0;
+
+    // detector side
+    std::atomic<uint64_t> _applied{0};
+    std::atomic<uint64_t> _last_apply_ns{0};
+    std::atomic<uint64_t> _max_apply_ns{0};
+};
+
+extern ConfigStore config_store;
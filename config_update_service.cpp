@@ -1,39 +1,232 @@
-#include "config_update_service.hpp"
-
-
-void load_config(const std::string& filename)
-{
-  std::ifstream file(filename);//input file stream
-  nlohmann::json json_instance;
-  
-  file>>json_instance;
-  
-  auto colour=json_instance.at("colour");
-  auto l1 = colour.at("lower");
-  auto u1 = colour.at("upper");
-  auto b=colour.at("behaviour");
-
-  HSVConfig new_config;
-    new_config.hue_min = l1[0];
-    new_config.sat_min = l1[1];
-    new_config.val_min = l1[2];
-    new_config.hue_max = u1[0];
-    new_config.sat_max = u1[1];
-    new_config.val_max = u1[2];
-    new_config.behaviour=b;
-    syslog(LOG_INFO,"loading new config");     
-   std::lock_guard<std::mutex> lock(config_mutex);
-   config = new_config;
-}
-
-void config_update_service()
-{ 	//keep  a track of the last modified time
-	static std::time_t last_mod_time = 0;
-    struct stat file_stat;
-     if (stat(CONFIG_FILE, &file_stat) == 0) {
-        if (file_stat.st_mtime != last_mod_time) {
-            last_mod_time = file_stat.st_mtime;
-            load_config(CONFIG_FILE);
-        }
-}
-}
+#include "config_update_service.hpp"
+#include "config_snapshot.hpp"
+#include <cstdio>
+#include <cstring>
+#include <ctime>
+#include <poll.h>
+#include <sys/inotify.h>
+#include <unistd.h>
+
+
+static std::atomic<uint64_t> reloads{0};
+static std::atomic<uint64_t> rejected{0};
+static std::atomic<uint64_t> foreign_events{0};
+
+static bool reject(const std::string& filename, const std::string& where, const char* what)
+{
+  syslog(LOG_ERR, "config: %s rejected, %s: %s", filename.c_str(), where.c_str(), what);
+  return false;
+}
+
+//[a, b, c] of integers within lo..hi
+static bool valid_triple(const nlohmann::json& j, int lo, int hi)
+{
+  if (!j.is_array() || j.size() != 3) return false;
+  for (int k = 0; k < 3; k++) {
+    if (!j[k].is_number_integer()) return false;
+    int x = j[k].get<int>();
+    if (x < lo || x > hi) return false;
+  }
+  return true;
+}
+
+//the structure load_config() reads, checked before any of it is used so a
+//bad or half-written file leaves the running config alone
+static bool validate_config(const nlohmann::json& j, const std::string& filename)
+{
+  if (!j.is_object()) return reject(filename, "top level", "not an object");
+
+  if (j.contains("classes")) {
+    const auto& classes = j.at("classes");
+    if (!classes.is_array() || classes.size() == 0) return reject(filename, "classes", "not a non-empty array");
+    int i = 0;
+    for (const auto& c : classes) {
+      std::string where = "classes[" + std::to_string(i++) + "]";
+      if (!c.is_object()) return reject(filename, where, "not an object");
+      if (c.contains("name") && !c.at("name").is_string()) return reject(filename, where + ".name", "not a string");
+      if (!c.contains("behaviour") || !c.at("behaviour").is_number_integer())
+        return reject(filename, where + ".behaviour", "missing or not an integer");
+      if (!c.contains("ranges") || !c.at("ranges").is_array() || c.at("ranges").size() == 0)
+        return reject(filename, where + ".ranges", "missing or not a non-empty array");
+      int k = 0;
+      for (const auto& range : c.at("ranges")) {
+        std::string at = where + ".ranges[" + std::to_string(k++) + "]";
+        if (!range.is_object() || !range.contains("lower") || !range.contains("upper"))
+          return reject(filename, at, "needs lower and upper");
+        if (!valid_triple(range.at("lower"), 0, 255) || !valid_triple(range.at("upper"), 0, 255))
+          return reject(filename, at, "lower/upper must be 3 integers in 0..255");
+      }
+    }
+  } else if (j.contains("colour")) {
+    //a negative min passes everything in the legacy form
+    const auto& colour = j.at("colour");
+    if (!colour.is_object()) return reject(filename, "colour", "not an object");
+    if (!colour.contains("lower") || !valid_triple(colour.at("lower"), -1, 255) ||
+        !colour.contains("upper") || !valid_triple(colour.at("upper"), -1, 255))
+      return reject(filename, "colour", "lower/upper must be 3 integers in -1..255");
+    if (!colour.contains("behaviour") || !colour.at("behaviour").is_number_integer())
+      return reject(filename, "colour.behaviour", "missing or not an integer");
+  } else {
+    return reject(filename, "top level", "needs \"classes\" or \"colour\"");
+  }
+
+  if (j.contains("decision")) {
+    const auto& decision = j.at("decision");
+    if (!decision.is_object()) return reject(filename, "decision", "not an object");
+    for (const char* key : {"left_x", "right_x", "bottom_y", "horizon_y", "fast_y", "medium_y"}) {
+      if (decision.contains(key) && !decision.at(key).is_number())
+        return reject(filename, std::string("decision.") + key, "not a number");
+    }
+  }
+  return true;
+}
+
+//one class from {"name", "behaviour", "ranges":[{"lower":[h,s,v],"upper":[h,s,v]}, ...]}
+static void parse_colour_class(const nlohmann::json& j, int index, ColourClass& cls)
+{
+  std::string name = j.value("name", "class" + std::to_string(index));
+  snprintf(cls.name, sizeof(cls.name), "%s", name.c_str());
+  cls.behaviour = j.at("behaviour");
+  cls.range_count = 0;
+  for (const auto& range : j.at("ranges")) {
+    if (cls.range_count == MAX_CLASS_RANGES) {
+      syslog(LOG_WARNING, "config: class %s has more than %d ranges, extra ignored",
+             cls.name, MAX_CLASS_RANGES);
+      break;
+    }
+    auto l = range.at("lower");
+    auto u = range.at("upper");
+    HSVRange& r = cls.ranges[cls.range_count++];
+    for (int k = 0; k < 3; k++) {
+      r.lower[k] = l[k];
+      r.upper[k] = u[k];
+    }
+  }
+}
+
+//optional {"decision": {"left_x", "right_x", "bottom_y", "horizon_y", "fast_y", "medium_y"}},
+//missing keys keep the original bands
+static DecisionMap parse_decision_map(const nlohmann::json& j)
+{
+  DecisionMap map;
+  map.left_x = j.value("left_x", map.left_x);
+  map.right_x = j.value("right_x", map.right_x);
+  map.bottom_y = j.value("bottom_y", map.bottom_y);
+  map.horizon_y = j.value("horizon_y", map.horizon_y);
+  map.fast_y = j.value("fast_y", map.fast_y);
+  map.medium_y = j.value("medium_y", map.medium_y);
+  return map;
+}
+
+bool load_config(const std::string& filename, bool timed)
+{
+  std::ifstream file(filename);//input file stream
+  if (!file) {
+    rejected++;
+    return reject(filename, "file", "cannot be opened");
+  }
+  struct stat file_stat{};
+  stat(filename.c_str(), &file_stat);
+
+  //no exceptions: a parse error is reported like any other invalid file
+  nlohmann::json json_instance = nlohmann::json::parse(file, nullptr, false);
+  if (json_instance.is_discarded()) {
+    rejected++;
+    return reject(filename, "file", "not valid JSON");
+  }
+  if (!validate_config(json_instance, filename)) {
+    rejected++;
+    return false;
+  }
+
+  HSVConfig new_config;
+  if (json_instance.contains("classes")) {
+    new_config.class_count = 0;
+    for (const auto& c : json_instance.at("classes")) {
+      if (new_config.class_count == MAX_COLOUR_CLASSES) {
+        syslog(LOG_WARNING, "config: more than %d colour classes, extra ignored", MAX_COLOUR_CLASSES);
+        break;
+      }
+      parse_colour_class(c, new_config.class_count, new_config.classes[new_config.class_count]);
+      new_config.class_count++;
+    }
+  } else {
+    //legacy single-threshold form, the hue band is inverted to catch red
+    auto colour=json_instance.at("colour");
+    auto l1 = colour.at("lower");
+    auto u1 = colour.at("upper");
+    auto b=colour.at("behaviour");
+    new_config.classes[0] = legacy_colour_class("laser", l1[0], u1[0], l1[1], u1[1], l1[2], u1[2], b);
+    new_config.class_count = 1;
+  }
+  DecisionMap decision;
+  if (json_instance.contains("decision")) decision = parse_decision_map(json_instance.at("decision"));
+    syslog(LOG_INFO,"loading new config");     
+   //thresholds, lookup table and decision map are built here, off the RT core;
+   //the file's mtime starts the write-to-first-frame clock
+   uint64_t written_ns = timed ? uint64_t(file_stat.st_mtim.tv_sec) * NSEC_PER_SEC + file_stat.st_mtim.tv_nsec : 0;
+   config_store.publish(new_config, decision, written_ns);
+   reloads++;
+   return true;
+}
+
+void config_update_service()
+{ 	//watch the directory rather than the file: editors and deploy scripts
+	//replace it with a rename, which a watch on the old inode would miss
+	static int inotify_fd = -1;
+	static std::string dir, name;
+	if (inotify_fd < 0) {
+		std::string path = CONFIG_FILE;
+		size_t slash = path.rfind('/');
+		dir = slash == std::string::npos ? "." : path.substr(0, slash);
+		name = slash == std::string::npos ? path : path.substr(slash + 1);
+		inotify_fd = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+		if (inotify_fd < 0 || inotify_add_watch(inotify_fd, dir.c_str(), IN_CLOSE_WRITE | IN_MOVED_TO) < 0) {
+			syslog(LOG_ERR, "config: cannot watch %s (%s), reloads are off", dir.c_str(), strerror(errno));
+			if (inotify_fd >= 0) close(inotify_fd);
+			inotify_fd = -1;
+			sleep(CONFIG_WATCH_TIMEOUT_MS / 1000 + 1);
+			return;
+		}
+		//whatever is there now, later versions arrive as events
+		if (access(CONFIG_FILE, R_OK) == 0) load_config(CONFIG_FILE);
+	}
+
+	//the timeout only bounds how long stopping the service takes. Other
+	//files written in the same directory (logs, recordings) are dropped
+	//here and the wait goes on, so they cannot make the service spin.
+	struct timespec now;
+	clock_gettime(CLOCK_MONOTONIC, &now);
+	int64_t until_ms = now.tv_sec * 1000LL + now.tv_nsec / 1000000 + CONFIG_WATCH_TIMEOUT_MS;
+	bool changed = false;
+	for (;;) {
+		clock_gettime(CLOCK_MONOTONIC, &now);
+		int64_t left_ms = until_ms - (now.tv_sec * 1000LL + now.tv_nsec / 1000000);
+		struct pollfd pfd{inotify_fd, POLLIN, 0};
+		if (left_ms <= 0 || poll(&pfd, 1, int(left_ms)) <= 0) break;
+		alignas(struct inotify_event) char events[4096];
+		ssize_t len;
+		while ((len = read(inotify_fd, events, sizeof(events))) > 0) {
+			for (char* p = events; p < events + len; ) {
+				auto* ev = reinterpret_cast<struct inotify_event*>(p);
+				//a write closed, or a finished file renamed into place
+				if (ev->len && name == ev->name) changed = true;
+				else foreign_events.fetch_add(1, std::memory_order_relaxed);
+				p += sizeof(struct inotify_event) + ev->len;
+			}
+		}
+		if (changed) break;
+	}
+	//several events (write, then rename) make one reload
+	if (changed) load_config(CONFIG_FILE, true);
+    //snapshots the services have moved past since the last reload
+    config_store.reclaim();
+}
+
+void log_config_reload_stats()
+{
+  syslog(LOG_INFO, "Config Reload Stats:");
+  syslog(LOG_INFO, "  Reloads / rejected    : %llu / %llu",
+         (unsigned long long)reloads.load(), (unsigned long long)rejected.load());
+  syslog(LOG_INFO, "  Other files' events   : %llu ignored", (unsigned long long)foreign_events.load());
+}
@@ -1,11 +1,23 @@
-#define CONFIG_FILE "Config.json"
-#include <nlohmann/json.hpp>
-#include <sys/stat.h> 
-#include <opencv2/opencv.hpp>
-#include "red_laser_service.hpp"
-#include <fstream>
-
-extern HSVConfig config; 
-extern 	std::mutex config_mutex;
-
-void config_update_service();
+#define CONFIG_FILE "Config.json"
+#include <nlohmann/json.hpp>
+#include <sys/stat.h> 
+#include <opencv2/opencv.hpp>
+#include "red_laser_service.hpp"
+#include <fstream>
+
+//how long the watcher blocks before checking whether it should stop
+#define CONFIG_WATCH_TIMEOUT_MS 250
+
+//parse and validate a config file and publish it as a new config snapshot;
+//false (and the running config kept) if it cannot be read or is invalid.
+//`timed`: the file was just written, time its way to the first frame.
+bool load_config(const std::string& filename, bool timed = false);
+
+//event driven: runs as a free-running service (period -1), blocking on
+//inotify events for CONFIG_FILE's directory. Loads the file on the first
+//call, then again whenever it is closed after writing or renamed into place.
+//Returns after a reload or CONFIG_WATCH_TIMEOUT_MS, whatever else is
+//written in the directory.
+void config_update_service();
+
+void log_config_reload_stats();
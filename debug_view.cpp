@@ -0,0 +1,252 @@
+/***************************************************************
+ * File: debug_view.cpp
+ * Description: Render thread and sinks of the debug view.
+ ***************************************************************/
+
+#include "debug_view.hpp"
+
+#include <cerrno>
+#include <cstring>
+#include <fcntl.h>
+#include <pthread.h>
+#include <sched.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <syslog.h>
+#include <unistd.h>
+
+DebugPublisher debug_view;
+
+DebugPublisher::~DebugPublisher()
+{
+    stop();
+}
+
+bool DebugPublisher::configure(const char* spec)
+{
+    if (strcmp(spec, "window") == 0) {
+        _sink = DEBUG_WINDOW;
+    } else if (strncmp(spec, "dir:", 4) == 0 && spec[4]) {
+        _sink = DEBUG_DIR;
+        _dir = spec + 4;
+        if (mkdir(_dir.c_str(), 0755) != 0 && errno != EEXIST) {
+            syslog(LOG_ERR, "Debug view: cannot create %s: %s", _dir.c_str(), strerror(errno));
+            return false;
+        }
+    } else if (strcmp(spec, "shm") == 0) {
+        _sink = DEBUG_SHM;
+    } else {
+        return false;
+    }
+    return true;
+}
+
+void DebugPublisher::start(int cpu)
+{
+    if (_sink == DEBUG_NONE || _renderer.joinable()) return;
+    _renderer = std::jthread([this](std::stop_token stop) { _renderLoop(stop); });
+
+    cpu_set_t cpuset;
+    CPU_ZERO(&cpuset);
+    CPU_SET(cpu, &cpuset);
+    if (pthread_setaffinity_np(_renderer.native_handle(), sizeof(cpu_set_t), &cpuset) != 0) {
+        syslog(LOG_ERR, "Debug view: failed to pin render thread to core %d", cpu);
+    }
+    struct sched_param param{};
+    param.sched_priority = 0;
+    pthread_setschedparam(_renderer.native_handle(), SCHED_OTHER, &param);
+    _active = true;
+}
+
+void DebugPublisher::stop()
+{
+    if (!_renderer.joinable()) return;
+    _active = false;
+    _renderer.request_stop();
+    _pending.release();
+    _renderer.join();
+
+    // give queued camera buffers back
+    for (DebugFrame& item : _queue) item.frame.reset();
+    _head = _tail = 0;
+    if (_sink == DEBUG_WINDOW) cv::destroyAllWindows();
+    _closeShm();
+    logStats();
+}
+
+void DebugPublisher::post(const FrameHandle& frame, const cv::Mat& mask, const cv::Rect& window,
+                          bool found, int x, int y)
+{
+    if (!active()) return;
+    _posted.fetch_add(1, std::memory_order_relaxed);
+
+    std::unique_lock<PiMutex> lock(_queue_mutex, std::try_to_lock);
+    if (!lock.owns_lock()) {
+        _dropped_busy.fetch_add(1, std::memory_order_relaxed);
+        return;
+    }
+
+    // drop-oldest: a full queue loses its head to make room, and the new
+    // frame takes over its count on _pending
+    bool replaced = _tail - _head == DEBUG_VIEW_DEPTH;
+    if (replaced) {
+        _queue[_head % DEBUG_VIEW_DEPTH].frame.reset();
+        ++_head;
+        _replaced.fetch_add(1, std::memory_order_relaxed);
+    }
+    int i = _tail % DEBUG_VIEW_DEPTH;
+    DebugFrame& item = _queue[i];
+
+    size_t frame_pixels = size_t(frame.width()) * frame.height();
+    if (_mask_storage[i].size() < frame_pixels) _mask_storage[i].resize(frame_pixels);
+    item.mask = cv::Mat(mask.rows, mask.cols, CV_8UC1, _mask_storage[i].data());
+    mask.copyTo(item.mask);
+
+    item.frame = frame;
+    item.window = window;
+    item.found = found;
+    item.x = x;
+    item.y = y;
+    ++_tail;
+    lock.unlock();
+    if (!replaced) _pending.release();
+}
+
+void DebugPublisher::_renderLoop(std::stop_token stop)
+{
+    DebugFrame item;
+    while (!stop.stop_requested()) {
+        _pending.acquire();
+        {
+            std::lock_guard<PiMutex> lock(_queue_mutex);
+            if (_head == _tail) continue;
+            DebugFrame& queued = _queue[_head % DEBUG_VIEW_DEPTH];
+            item.frame = std::move(queued.frame);
+            item.mask = queued.mask.clone();
+            item.window = queued.window;
+            item.found = queued.found;
+            item.x = queued.x;
+            item.y = queued.y;
+            ++_head;
+        }
+        _render(item);
+        //the camera buffer goes back now, not when the next frame comes
+        item.frame.reset();
+        _rendered.fetch_add(1, std::memory_order_relaxed);
+    }
+}
+
+void DebugPublisher::_render(DebugFrame& item)
+{
+    cv::Mat yuyv(item.frame.height(), item.frame.width(), CV_8UC2,
+                 const_cast<uint8_t*>(item.frame.data()), item.frame.stride());
+    cv::cvtColor(yuyv, _bgr, cv::COLOR_YUV2BGR_YUYV);
+    uint32_t sequence = item.frame.sequence();
+    item.frame.reset();     // the camera buffer is not needed past the conversion
+
+    // mask pixels in magenta, search window in blue, centroid in green
+    cv::Mat window_bgr = _bgr(item.window);
+    //coarse-to-fine scans build no window-sized mask
+    bool masked = item.mask.rows == item.window.height && item.mask.cols == item.window.width;
+    if (masked) window_bgr.setTo(cv::Scalar(255, 0, 255), item.mask);
+    if (item.window.width != _bgr.cols || item.window.height != _bgr.rows) {
+        cv::rectangle(_bgr, item.window, cv::Scalar(255, 0, 0), 1);
+    }
+    if (item.found) cv::circle(_bgr, cv::Point(item.x, item.y), 5, cv::Scalar(0, 255, 0), -1);
+
+    switch (_sink) {
+        case DEBUG_WINDOW:
+            // class bits are small values, show any class as white
+            if (masked) {
+                cv::threshold(item.mask, _mask_view, 0, 255, cv::THRESH_BINARY);
+                cv::imshow("Filtered Frame", _mask_view);
+            }
+            cv::imshow("Red Laser Detection", _bgr);
+            cv::waitKey(1);
+            break;
+        case DEBUG_DIR: {
+            char path[512];
+            snprintf(path, sizeof(path), "%s/frame_%06u.jpg", _dir.c_str(), sequence);
+            cv::imwrite(path, _bgr, {cv::IMWRITE_JPEG_QUALITY, 85});
+            break;
+        }
+        case DEBUG_SHM: {
+            if (!_shm && !_openShm(_bgr.cols, _bgr.rows)) break;
+            DebugShmHeader* header = reinterpret_cast<DebugShmHeader*>(_shm);
+            if (header->width != uint32_t(_bgr.cols) || header->height != uint32_t(_bgr.rows)) break;
+
+            uint64_t latest = header->latest.load(std::memory_order_relaxed) + 1;
+            uint8_t* base = _shm + 64 + (latest % DEBUG_SHM_SLOTS) * debug_shm_slot_bytes(header->width, header->height);
+            DebugShmSlot* slot = reinterpret_cast<DebugShmSlot*>(base);
+            uint64_t seq = slot->seq.load(std::memory_order_relaxed);
+            slot->seq.store(seq + 1, std::memory_order_relaxed);
+            std::atomic_thread_fence(std::memory_order_release);
+            slot->frame_sequence = sequence;
+            slot->found = item.found;
+            slot->x = item.x;
+            slot->y = item.y;
+            uint8_t* pixels = base + sizeof(DebugShmSlot);
+            for (int r = 0; r < _bgr.rows; ++r) {
+                memcpy(pixels + size_t(r) * _bgr.cols * 3, _bgr.ptr<uint8_t>(r), size_t(_bgr.cols) * 3);
+            }
+            slot->seq.store(seq + 2, std::memory_order_release);
+            header->latest.store(latest, std::memory_order_release);
+            break;
+        }
+        default:
+            break;
+    }
+}
+
+bool DebugPublisher::_openShm(int width, int height)
+{
+    int fd = shm_open(DEBUG_SHM_NAME, O_RDWR | O_CREAT, 0644);
+    if (fd < 0) {
+        syslog(LOG_ERR, "Debug view: shm_open %s failed: %s", DEBUG_SHM_NAME, strerror(errno));
+        _sink = DEBUG_NONE;
+        return false;
+    }
+    _shm_size = debug_shm_size(width, height);
+    if (ftruncate(fd, _shm_size) != 0) {
+        syslog(LOG_ERR, "Debug view: cannot size %s: %s", DEBUG_SHM_NAME, strerror(errno));
+        close(fd);
+        _sink = DEBUG_NONE;
+        return false;
+    }
+    void* map = mmap(NULL, _shm_size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    close(fd);
+    if (map == MAP_FAILED) {
+        syslog(LOG_ERR, "Debug view: mmap failed: %s", strerror(errno));
+        _sink = DEBUG_NONE;
+        return false;
+    }
+    _shm = static_cast<uint8_t*>(map);
+    memset(_shm, 0, _shm_size);
+
+    DebugShmHeader* header = reinterpret_cast<DebugShmHeader*>(_shm);
+    header->width = width;
+    header->height = height;
+    header->slots = DEBUG_SHM_SLOTS;
+    header->latest.store(0, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_release);
+    header->magic = DEBUG_SHM_MAGIC;
+    syslog(LOG_INFO, "Debug view: publishing %dx%d frames to shm %s", width, height, DEBUG_SHM_NAME);
+    return true;
+}
+
+void DebugPublisher::_closeShm()
+{
+    if (!_shm) return;
+    munmap(_shm, _shm_size);
+    shm_unlink(DEBUG_SHM_NAME);
+    _shm = nullptr;
+}
+
+void DebugPublisher::logStats() const
+{
+    syslog(LOG_INFO, "Debug View Stats:");
+    syslog(LOG_INFO, "  Posted / rendered     : %llu / %llu", (unsigned long long)_posted.load(),
+           (unsigned long long)_rendered.load());
+    syslog(LOG_INFO, "  Replaced / busy drops : %llu / %llu", (unsigned long long)_replaced.load(),
+           (unsigned long long)_dropped_busy.load());
+}
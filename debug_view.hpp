@@ -0,0 +1,135 @@
+/***************************************************************
+ * File: debug_view.hpp
+ * Description: Asynchronous debug view for the laser detector. The
+ *              detector only posts the frame handle, a copy of the mask
+ *              and the detection result into a drop-oldest queue; a
+ *              low-priority thread on another core converts, annotates
+ *              and hands the image to a sink:
+ *
+ *                window : imshow/waitKey, as the detector used to do
+ *                dir    : numbered JPEG files in a directory
+ *                shm    : shared-memory ring read by debug_viewer
+ *
+ *              Nothing here ever blocks the detector; when the render
+ *              thread holds the queue the post is dropped and counted.
+ ***************************************************************/
+
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <mutex>
+#include <semaphore>
+#include <string>
+#include <thread>
+#include <vector>
+#include <opencv2/opencv.hpp>
+#include "frame_ring.hpp"
+#include "pi_mutex.hpp"
+
+// Queued debug frames, on top of the one being rendered; counted in
+// capture_buffers_needed()
+#define DEBUG_VIEW_DEPTH 1
+
+// Core the render thread runs on, away from the RT services on core 1
+#define DEBUG_VIEW_CPU 3
+
+// Shared-memory ring for the shm sink, see debug_viewer.cpp
+#define DEBUG_SHM_NAME  "/rtes_cat_bot_debug"
+#define DEBUG_SHM_MAGIC 0x31474244u     // "DBG1"
+#define DEBUG_SHM_SLOTS 3
+
+struct DebugShmHeader {
+    uint32_t magic;
+    uint32_t width, height;             // BGR, 3 bytes per pixel, no padding
+    uint32_t slots;
+    std::atomic<uint64_t> latest;       // sequence of the newest complete image
+};
+
+// Per-slot seqlock: odd while the slot is being written
+struct DebugShmSlot {
+    std::atomic<uint64_t> seq;
+    uint64_t frame_sequence;
+    int32_t found, x, y;
+};
+
+inline size_t debug_shm_slot_bytes(uint32_t width, uint32_t height)
+{
+    return (sizeof(DebugShmSlot) + size_t(width) * height * 3 + 63) & ~size_t(63);
+}
+
+inline size_t debug_shm_size(uint32_t width, uint32_t height)
+{
+    return 64 + DEBUG_SHM_SLOTS * debug_shm_slot_bytes(width, height);
+}
+
+enum DebugSink {
+    DEBUG_NONE,
+    DEBUG_WINDOW,
+    DEBUG_DIR,
+    DEBUG_SHM
+};
+
+// One detection to draw
+struct DebugFrame {
+    FrameHandle frame;
+    cv::Mat mask;               // window-sized copy
+    cv::Rect window;
+    bool found = false;
+    int x = 0, y = 0;
+};
+
+class DebugPublisher {
+public:
+    ~DebugPublisher();
+
+    // "window", "dir:PATH" or "shm"; false if unknown
+    bool configure(const char* spec);
+
+    // Start the render thread on `cpu` (SCHED_OTHER)
+    void start(int cpu = DEBUG_VIEW_CPU);
+    void stop();
+
+    bool active() const { return _active.load(std::memory_order_relaxed); }
+
+    // A sink was configured, so it will hold frames once started
+    bool configured() const { return _sink != DEBUG_NONE; }
+
+    // Called from the detector, never blocks: replaces the oldest queued
+    // frame, or drops this one if the render thread has the queue
+    void post(const FrameHandle& frame, const cv::Mat& mask, const cv::Rect& window,
+              bool found, int x, int y);
+
+    void logStats() const;
+
+private:
+    void _renderLoop(std::stop_token stop);
+    void _render(DebugFrame& item);
+    bool _openShm(int width, int height);
+    void _closeShm();
+
+    DebugSink _sink = DEBUG_NONE;
+    std::string _dir;
+
+    // the detector only ever try-locks it, priority inheritance covers
+    // the renderer being preempted while it holds the queue
+    PiMutex _queue_mutex{"debug queue"};
+    DebugFrame _queue[DEBUG_VIEW_DEPTH];
+    std::vector<uint8_t> _mask_storage[DEBUG_VIEW_DEPTH];  // full-frame sized, so posts do not allocate
+    uint64_t _head = 0, _tail = 0;
+    std::counting_semaphore<> _pending{0};   // one per queued frame, plus stop
+    std::jthread _renderer;
+    std::atomic<bool> _active{false};
+
+    cv::Mat _bgr;
+    cv::Mat _mask_view;
+    uint8_t* _shm = nullptr;
+    size_t _shm_size = 0;
+
+    std::atomic<uint64_t> _posted{0};
+    std::atomic<uint64_t> _replaced{0};         // oldest dropped for a newer one
+    std::atomic<uint64_t> _dropped_busy{0};     // render thread held the queue
+    std::atomic<uint64_t> _rendered{0};
+};
+
+extern DebugPublisher debug_view;
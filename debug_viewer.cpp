@@ -0,0 +1,80 @@
+/***************************************************************
+ * File: debug_viewer.cpp
+ * Description: Shows the debug view the robot publishes with
+ *              `-V shm` (debug_view.hpp). Runs as a separate, ordinary
+ *              process, so a display, X forwarding or a slow GUI never
+ *              touches the real-time pipeline.
+ *
+ * usage: debug_viewer        (q or Esc to quit)
+ ***************************************************************/
+
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <unistd.h>
+#include "debug_view.hpp"
+
+int main()
+{
+    int fd = shm_open(DEBUG_SHM_NAME, O_RDONLY, 0);
+    if (fd < 0) {
+        fprintf(stderr, "no debug view at %s, start the robot with -V shm\n", DEBUG_SHM_NAME);
+        return EXIT_FAILURE;
+    }
+
+    // map the header first to learn the frame size
+    void* map = mmap(NULL, 64, PROT_READ, MAP_SHARED, fd, 0);
+    if (map == MAP_FAILED) {
+        perror("mmap");
+        return EXIT_FAILURE;
+    }
+    const DebugShmHeader* header = static_cast<const DebugShmHeader*>(map);
+    while (header->magic != DEBUG_SHM_MAGIC) usleep(100000);
+    uint32_t width = header->width, height = header->height;
+    munmap(map, 64);
+
+    size_t size = debug_shm_size(width, height);
+    map = mmap(NULL, size, PROT_READ, MAP_SHARED, fd, 0);
+    close(fd);
+    if (map == MAP_FAILED) {
+        perror("mmap");
+        return EXIT_FAILURE;
+    }
+    const uint8_t* shm = static_cast<const uint8_t*>(map);
+    header = reinterpret_cast<const DebugShmHeader*>(shm);
+
+    cv::Mat image(height, width, CV_8UC3);
+    uint64_t shown = 0;
+    while (true) {
+        uint64_t latest = header->latest.load(std::memory_order_acquire);
+        if (latest != shown) {
+            const uint8_t* base = shm + 64 + (latest % DEBUG_SHM_SLOTS) * debug_shm_slot_bytes(width, height);
+            const DebugShmSlot* slot = reinterpret_cast<const DebugShmSlot*>(base);
+
+            // seqlock read, retried on the next poll if the writer lapped us
+            uint64_t seq = slot->seq.load(std::memory_order_acquire);
+            uint32_t sequence = uint32_t(slot->frame_sequence);
+            bool found = slot->found;
+            int x = slot->x, y = slot->y;
+            for (uint32_t r = 0; r < height; ++r) {
+                memcpy(image.ptr<uint8_t>(r), base + sizeof(DebugShmSlot) + size_t(r) * width * 3, size_t(width) * 3);
+            }
+            std::atomic_thread_fence(std::memory_order_acquire);
+            if (!(seq & 1) && slot->seq.load(std::memory_order_relaxed) == seq) {
+                shown = latest;
+                char title[64];
+                if (found) snprintf(title, sizeof(title), "frame %u  laser %d,%d", sequence, x, y);
+                else snprintf(title, sizeof(title), "frame %u  no laser", sequence);
+                cv::putText(image, title, cv::Point(8, 20), cv::FONT_HERSHEY_SIMPLEX, 0.5,
+                            cv::Scalar(255, 255, 255), 1);
+                cv::imshow("Red Laser Detection", image);
+            }
+        }
+        int key = cv::waitKey(15);
+        if (key == 'q' || key == 27) break;
+    }
+    munmap(map, size);
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,664 @@
+/***************************************************************
+ * File: detect_bench.cpp
+ * Description: Offline benchmark for the detection path.
+ *
+ *   1. Mask paths: every recorded frame goes through each mask builder
+ *      (OpenCV chain, every fused YUYV kernel this CPU supports and the
+ *      colour lookup table) side by side; the timings and the pixels where a path disagrees with
+ *      the original OpenCV chain are reported.
+ *   2. Blob extraction: the old findContours + contourArea + moments
+ *      loop (last contour wins) against the single-pass labeller (best
+ *      blob under -S wins) on the same masks, timing and agreement.
+ *   3. Stripes: full-frame mask + labelling split over 1-4 workers
+ *      (helpers pinned to -C cores, default 0,2,3), speedup and tail
+ *      latency against one worker; blobs must match the serial labeller.
+ *   4. Throughput: the recording is replayed as fast as possible through
+ *      the same capture and detection services the sequencer runs (with
+ *      -W stripes per frame, -P pyramid level), and
+ *      the maximum sustainable frame rate is reported together with the
+ *      pixels the tracking window scanned per frame (-F: always full)
+ *      and the frames the change gate skipped (-G threshold, 0: off).
+ *   5. Pyramid: every frame scanned in full at level 1 (full resolution),
+ *      2 and 4 (sampled mask, refined in windows), capture and detect
+ *      cost per level and the frames whose detections differ from level 1.
+ *      Needs the lut path.
+ *
+ *   -t N runs a bit-exactness check instead: N random HSVConfig values
+ *      on random frames, and on recorded ones if a recording is given,
+ *      every fused kernel must match an OpenCV reference exactly: the
+ *      original thresholdImage chain for a legacy config, cv::inRange on
+ *      each class's raw ranges otherwise. Exit status is non-zero on any
+ *      mismatch.
+ *
+ * usage: detect_bench recording.yuyv [-c Config.json] [-d lut|yuyv|bgr]
+ *                    [-k scalar|sse4.1|avx2|neon] [-F]
+ *                    [-S largest|brightest|closest] [-W n] [-C cores] [-G n] [-P level]
+ *        detect_bench -t N [recording.yuyv]
+ ***************************************************************/
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <random>
+#include <string>
+#include <tuple>
+#include <unistd.h>
+#include <vector>
+#include "cameraService.hpp"
+#include "colour_lut.hpp"
+#include "config_snapshot.hpp"
+#include "detect_stripes.hpp"
+#include "config_update_service.hpp"
+#include "laser_pipeline.hpp"
+#include "laser_mask.hpp"
+#include "red_laser_service.hpp"
+#include "replay_source.hpp"
+
+typedef std::chrono::steady_clock bench_clock;
+
+static double elapsed_ms(bench_clock::time_point t0)
+{
+    return std::chrono::duration<double, std::milli>(bench_clock::now() - t0).count();
+}
+
+// per-frame timings of one code path
+struct Timing {
+    const char* name;
+    std::vector<double> ms;
+
+    void print() const
+    {
+        std::vector<double> sorted = ms;
+        std::sort(sorted.begin(), sorted.end());
+        double sum = 0;
+        for (double v : ms) sum += v;
+        auto pct = [&](double p) {
+            return sorted.empty() ? 0.0 : sorted[size_t(p * (sorted.size() - 1) + 0.5)];
+        };
+        printf("  %-22s mean %7.3f  p50 %7.3f  p99 %7.3f  max %7.3f ms\n", name,
+               sum / std::max<size_t>(1, ms.size()), pct(0.5), pct(0.99),
+               sorted.empty() ? 0.0 : sorted.back());
+    }
+};
+
+static uint64_t count_mismatch(const cv::Mat& a, const cv::Mat& b)
+{
+    uint64_t n = 0;
+    for (int y = 0; y < a.rows; ++y) {
+        const uint8_t* pa = a.ptr<uint8_t>(y);
+        const uint8_t* pb = b.ptr<uint8_t>(y);
+        for (int x = 0; x < a.cols; ++x) n += pa[x] != pb[x];
+    }
+    return n;
+}
+
+static void bench_mask_paths(const char* path, const HSVConfig& cfg)
+{
+    ReplaySource src(path, false);
+    if (src.open() != EXIT_SUCCESS) return;
+
+    struct KernelRun {
+        MaskKernelIsa isa;
+        Timing timing;
+        uint64_t mismatched_pixels, mismatched_frames;
+    };
+    std::vector<KernelRun> kernels;
+    for (int i = 0; i < KERNEL_COUNT; ++i) {
+        MaskKernelIsa isa = static_cast<MaskKernelIsa>(i);
+        if (mask_kernel(isa)) kernels.push_back({isa, {mask_kernel_name(isa), {}}, 0, 0});
+    }
+    MaskKernelIsa selected = selected_mask_kernel();
+
+    Timing bgr_path{"bgr (opencv chain)", {}};
+    Timing lut_path{"lut", {}};
+    uint64_t lut_mismatched_pixels = 0, lut_mismatched_frames = 0;
+    ColourLut lut;
+    auto t_build = bench_clock::now();
+    build_colour_lut(cfg, lut);
+    double build_ms = elapsed_ms(t_build);
+    uint64_t total_pixels = 0;
+    cv::Mat bgr, reference, mask;
+
+    FrameHandle frame;
+    while (!src.finished()) {
+        if (!src.grab(frame)) continue;
+        cv::Mat yuyv(frame.height(), frame.width(), CV_8UC2,
+                     const_cast<uint8_t*>(frame.data()), frame.stride());
+
+        auto t0 = bench_clock::now();
+        cv::cvtColor(yuyv, bgr, cv::COLOR_YUV2BGR_YUYV);
+        mask_from_bgr(bgr, cfg, reference);
+        bgr_path.ms.push_back(elapsed_ms(t0));
+
+        for (KernelRun& k : kernels) {
+            select_mask_kernel(k.isa);
+            t0 = bench_clock::now();
+            mask_from_yuyv(frame.data(), frame.width(), frame.height(), frame.stride(), cfg, mask);
+            k.timing.ms.push_back(elapsed_ms(t0));
+
+            uint64_t n = count_mismatch(reference, mask);
+            k.mismatched_pixels += n;
+            k.mismatched_frames += n != 0;
+        }
+
+        t0 = bench_clock::now();
+        mask_from_lut(frame.data(), frame.width(), frame.height(), frame.stride(), lut, mask);
+        lut_path.ms.push_back(elapsed_ms(t0));
+        uint64_t n = count_mismatch(reference, mask);
+        lut_mismatched_pixels += n;
+        lut_mismatched_frames += n != 0;
+
+        total_pixels += uint64_t(frame.width()) * frame.height();
+        frame.reset();
+    }
+    select_mask_kernel(selected);
+
+    printf("mask paths over %zu frames:\n", bgr_path.ms.size());
+    bgr_path.print();
+    for (const KernelRun& k : kernels) {
+        k.timing.print();
+        printf("    vs opencv chain      %llu of %llu pixels differ (%llu frames)\n",
+               (unsigned long long)k.mismatched_pixels, (unsigned long long)total_pixels,
+               (unsigned long long)k.mismatched_frames);
+    }
+    lut_path.print();
+    printf("    vs opencv chain      %llu of %llu pixels differ (%llu frames), %.6f%%\n",
+           (unsigned long long)lut_mismatched_pixels, (unsigned long long)total_pixels,
+           (unsigned long long)lut_mismatched_frames,
+           100.0 * lut_mismatched_pixels / std::max<uint64_t>(1, total_pixels));
+    printf("    table build          %.3f ms (%d cells)\n", build_ms, LUT_CELLS);
+}
+
+// A config for the kernel check, with the thresholds a legacy one was
+// made from so the reference does not go through legacy_colour_class()
+struct RandomConfig {
+    HSVConfig cfg;
+    bool legacy = false;
+    int hue_min = 0, hue_max = 0, sat_min = 0, sat_max = 0, val_min = 0, val_max = 0;
+};
+
+// Random thresholds, including negative minimums and maximums past 255.
+// Every other config is a single legacy class, the rest carry several
+// classes with several (possibly overlapping or empty) ranges each.
+static RandomConfig random_config(std::mt19937& rng)
+{
+    std::uniform_int_distribution<int> lo(-20, 240), hi(0, 300);
+    std::uniform_int_distribution<int> classes(1, MAX_COLOUR_CLASSES), ranges(1, MAX_CLASS_RANGES);
+    RandomConfig random;
+    HSVConfig& cfg = random.cfg;
+    if (rng() & 1) {
+        random.legacy = true;
+        random.hue_min = lo(rng); random.hue_max = hi(rng);
+        random.sat_min = lo(rng); random.sat_max = hi(rng);
+        random.val_min = lo(rng); random.val_max = hi(rng);
+        cfg.classes[0] = legacy_colour_class("laser", random.hue_min, random.hue_max, random.sat_min,
+                                             random.sat_max, random.val_min, random.val_max, 1);
+        return random;
+    }
+    cfg.class_count = classes(rng);
+    for (int c = 0; c < cfg.class_count; ++c) {
+        ColourClass& cls = cfg.classes[c];
+        cls = ColourClass{};
+        cls.range_count = ranges(rng);
+        for (int r = 0; r < cls.range_count; ++r) {
+            for (int k = 0; k < 3; ++k) {
+                cls.ranges[r].lower[k] = lo(rng);
+                cls.ranges[r].upper[k] = hi(rng);
+            }
+        }
+    }
+    return random;
+}
+
+// The original detector's thresholdImage(): min < x <= max
+static void threshold_image(cv::Mat& channel, int minimum, int maximum)
+{
+    cv::Mat tmp;
+    cv::threshold(channel, tmp, maximum, 0, cv::THRESH_TOZERO_INV);
+    cv::threshold(tmp, channel, minimum, 255, cv::THRESH_BINARY);
+}
+
+// What the kernels must produce, from OpenCV alone. A legacy config runs
+// the original chain (three thresholds, inverted hue, AND) and sets class
+// 0's bit where it passed; a class config ORs each class's bit in where
+// cv::inRange passes one of its ranges as written in the config.
+static void reference_mask(const cv::Mat& bgr, const RandomConfig& random, cv::Mat& mask)
+{
+    cv::Mat hsv;
+    cv::cvtColor(bgr, hsv, cv::COLOR_BGR2HSV);
+    if (random.legacy) {
+        std::vector<cv::Mat> channels;
+        cv::split(hsv, channels);
+        threshold_image(channels[0], random.hue_min, random.hue_max);
+        threshold_image(channels[1], random.sat_min, random.sat_max);
+        threshold_image(channels[2], random.val_min, random.val_max);
+        cv::bitwise_not(channels[0], channels[0]);
+        cv::Mat chain = channels[0] & channels[1] & channels[2];
+        cv::threshold(chain, mask, 0, 1, cv::THRESH_BINARY);
+        return;
+    }
+    mask.create(bgr.rows, bgr.cols, CV_8UC1);
+    mask.setTo(cv::Scalar(0));
+    cv::Mat in_range;
+    for (int c = 0; c < random.cfg.class_count; ++c) {
+        const ColourClass& cls = random.cfg.classes[c];
+        for (int r = 0; r < cls.range_count; ++r) {
+            const HSVRange& range = cls.ranges[r];
+            cv::inRange(hsv, cv::Scalar(range.lower[0], range.lower[1], range.lower[2]),
+                        cv::Scalar(range.upper[0], range.upper[1], range.upper[2]), in_range);
+            cv::bitwise_or(mask, cv::Scalar(1 << c), mask, in_range);
+        }
+    }
+}
+
+// `path` may be null, the random frames alone then
+static bool verify_kernels(const char* path, int iterations)
+{
+    std::mt19937 rng(5623);
+    std::vector<cv::Mat> frames;
+
+    // random frames hit every YUV combination, recorded frames the real ones
+    for (int i = 0; i < 4; ++i) {
+        cv::Mat yuyv(FRAME_HEIGHT, FRAME_WIDTH, CV_8UC2);
+        for (int y = 0; y < yuyv.rows; ++y) {
+            uint8_t* p = yuyv.ptr<uint8_t>(y);
+            for (int x = 0; x < yuyv.cols * 2; ++x) p[x] = rng() & 0xff;
+        }
+        frames.push_back(yuyv);
+    }
+    ReplaySource src(path ? path : "", false);
+    if (path && src.open() == EXIT_SUCCESS) {
+        FrameHandle frame;
+        for (uint32_t i = 0; i < src.frame_count() && frames.size() < 16; i += 8) {
+            while (!src.finished() && !src.grab(frame)) {}
+            if (frame.empty()) break;
+            cv::Mat yuyv(frame.height(), frame.width(), CV_8UC2,
+                         const_cast<uint8_t*>(frame.data()), frame.stride());
+            frames.push_back(yuyv.clone());
+            frame.reset();
+        }
+    }
+
+    bool exact = true;
+    cv::Mat bgr, reference, mask;
+    MaskKernelIsa selected = selected_mask_kernel();
+    for (int it = 0; it < iterations; ++it) {
+        RandomConfig random = random_config(rng);
+        const HSVConfig& cfg = random.cfg;
+        const cv::Mat& yuyv = frames[it % frames.size()];
+        cv::cvtColor(yuyv, bgr, cv::COLOR_YUV2BGR_YUYV);
+        reference_mask(bgr, random, reference);
+
+        for (int i = 0; i < KERNEL_COUNT; ++i) {
+            MaskKernelIsa isa = static_cast<MaskKernelIsa>(i);
+            if (!mask_kernel(isa)) continue;
+            select_mask_kernel(isa);
+            mask_from_yuyv(yuyv.ptr<uint8_t>(0), yuyv.cols, yuyv.rows, yuyv.step[0], cfg, mask);
+            uint64_t n = count_mismatch(reference, mask);
+            if (n && random.legacy) {
+                exact = false;
+                printf("MISMATCH %s: %llu pixels, legacy hue %d..%d sat %d..%d val %d..%d\n",
+                       mask_kernel_name(isa), (unsigned long long)n, random.hue_min, random.hue_max,
+                       random.sat_min, random.sat_max, random.val_min, random.val_max);
+            } else if (n) {
+                exact = false;
+                const HSVRange& r = cfg.classes[0].ranges[0];
+                printf("MISMATCH %s: %llu pixels, %d classes, first range %d,%d,%d..%d,%d,%d\n",
+                       mask_kernel_name(isa), (unsigned long long)n, cfg.class_count,
+                       r.lower[0], r.lower[1], r.lower[2], r.upper[0], r.upper[1], r.upper[2]);
+            }
+        }
+    }
+    select_mask_kernel(selected);
+
+    printf("kernel check: %d random configs on %zu frames: %s\n", iterations, frames.size(),
+           exact ? "bit-exact" : "FAILED");
+    return exact;
+}
+
+// The detector's loop before the labeller: every contour of area >= 5
+// overwrites the result, so the last one wins
+static bool contour_centroid(cv::Mat& mask, int& cx, int& cy)
+{
+    std::vector<std::vector<cv::Point>> contours;
+    cv::findContours(mask, contours, cv::RETR_EXTERNAL, cv::CHAIN_APPROX_SIMPLE);
+    bool found = false;
+    for (const auto& contour : contours) {
+        if (cv::contourArea(contour) < 5) continue;
+        cv::Moments m = cv::moments(contour);
+        if (m.m00 != 0) {
+            cx = int(m.m10 / m.m00);
+            cy = int(m.m01 / m.m00);
+            found = true;
+        }
+    }
+    return found;
+}
+
+static void bench_blob_paths(const char* path, const HSVConfig& cfg)
+{
+    ReplaySource src(path, false);
+    if (src.open() != EXIT_SUCCESS) return;
+
+    Timing contour_path{"findContours+moments", {}};
+    Timing blob_path{"blob labeller", {}};
+    uint64_t frames = 0, found_both = 0, found_contour = 0, found_blob = 0, multi_blob = 0;
+    double distance = 0;
+    BlobLabeller labeller;
+    cv::Mat mask, scratch;
+
+    FrameHandle frame;
+    while (!src.finished()) {
+        if (!src.grab(frame)) continue;
+        mask_from_yuyv(frame.data(), frame.width(), frame.height(), frame.stride(), cfg, mask);
+        ++frames;
+
+        // findContours modifies its input on older OpenCV versions
+        mask.copyTo(scratch);
+        int ccx = 0, ccy = 0;
+        auto t0 = bench_clock::now();
+        bool contour_found = contour_centroid(scratch, ccx, ccy);
+        contour_path.ms.push_back(elapsed_ms(t0));
+
+        t0 = bench_clock::now();
+        int blobs = labeller.label(mask, frame.data(), frame.stride());
+        const Blob* best = labeller.best(0, blob_score);
+        blob_path.ms.push_back(elapsed_ms(t0));
+
+        found_contour += contour_found;
+        found_blob += best != nullptr;
+        multi_blob += blobs > 1;
+        if (contour_found && best) {
+            ++found_both;
+            double dx = best->cx() - ccx, dy = best->cy() - ccy;
+            distance += std::sqrt(dx * dx + dy * dy);
+        }
+        frame.reset();
+    }
+
+    printf("blob extraction over %llu frames:\n", (unsigned long long)frames);
+    contour_path.print();
+    blob_path.print();
+    printf("    found: contours %llu, labeller %llu, %llu frames with several blobs\n",
+           (unsigned long long)found_contour, (unsigned long long)found_blob,
+           (unsigned long long)multi_blob);
+    printf("    mean centroid distance when both found: %.2f px\n",
+           found_both ? distance / found_both : 0.0);
+}
+
+static std::vector<int> stripe_cores = {0, 2, 3};
+
+static bool same_blobs(std::vector<Blob> a, std::vector<Blob> b)
+{
+    auto order = [](const Blob& x, const Blob& y) {
+        return std::tie(x.cls, x.y0, x.x0, x.area) < std::tie(y.cls, y.y0, y.x0, y.area);
+    };
+    std::sort(a.begin(), a.end(), order);
+    std::sort(b.begin(), b.end(), order);
+    if (a.size() != b.size()) return false;
+    for (size_t i = 0; i < a.size(); ++i) {
+        if (a[i].cls != b[i].cls || a[i].area != b[i].area || a[i].m10 != b[i].m10 || a[i].m01 != b[i].m01 ||
+            a[i].luma != b[i].luma) {
+            return false;
+        }
+    }
+    return true;
+}
+
+static void bench_stripes(const char* path, const HSVConfig& cfg)
+{
+    const ConfigSnapshot* snapshot = config_store.current();
+    const ColourLut* lut = detect_path == DETECT_LUT ? &snapshot->lut : nullptr;
+    printf("stripes (%s, full frame):\n", lut ? "lut" : "yuyv kernel");
+
+    double base_mean = 0, base_p99 = 0;
+    for (int workers = 1; workers <= STRIPE_MAX_WORKERS; ++workers) {
+        ReplaySource src(path, false);
+        if (src.open() != EXIT_SUCCESS) return;
+        stripe_pool.configure(workers, stripe_cores);
+
+        char name[32];
+        snprintf(name, sizeof(name), "%d worker%s", workers, workers > 1 ? "s" : "");
+        Timing timing{name, {}};
+        uint64_t mismatched_frames = 0;
+        BlobLabeller serial;
+        cv::Mat mask, serial_mask;
+        std::vector<Blob> blobs;
+
+        FrameHandle frame;
+        while (!src.finished()) {
+            if (!src.grab(frame)) continue;
+            StripeJob job{frame.data(), frame.width(), frame.height(), frame.stride(), lut, &snapshot->thresholds, &mask};
+            auto t0 = bench_clock::now();
+            stripe_pool.run(job, BLOB_MIN_AREA, blobs);
+            timing.ms.push_back(elapsed_ms(t0));
+
+            if (lut) mask_from_lut(frame.data(), frame.width(), frame.height(), frame.stride(), *lut, serial_mask);
+            else mask_from_yuyv(frame.data(), frame.width(), frame.height(), frame.stride(), cfg, serial_mask);
+            serial.label(serial_mask, frame.data(), frame.stride());
+            mismatched_frames += !same_blobs(blobs, serial.blobs());
+            frame.reset();
+        }
+
+        std::vector<double> sorted = timing.ms;
+        std::sort(sorted.begin(), sorted.end());
+        double mean = 0;
+        for (double v : sorted) mean += v;
+        mean /= std::max<size_t>(1, sorted.size());
+        double p99 = sorted.empty() ? 0.0 : sorted[size_t(0.99 * (sorted.size() - 1) + 0.5)];
+        if (workers == 1) {
+            base_mean = mean;
+            base_p99 = p99;
+        }
+        timing.print();
+        printf("    speedup %.2fx mean, %.2fx p99, %llu frames differ from serial\n",
+               mean > 0 ? base_mean / mean : 0.0, p99 > 0 ? base_p99 / p99 : 0.0,
+               (unsigned long long)mismatched_frames);
+    }
+    stripe_pool.stop();
+}
+
+struct FrameResult {
+    ClassDetection points[MAX_COLOUR_CLASSES];
+};
+
+static bool same_points(const FrameResult& a, const FrameResult& b)
+{
+    for (int c = 0; c < MAX_COLOUR_CLASSES; ++c) {
+        const ClassDetection& p = a.points[c];
+        const ClassDetection& q = b.points[c];
+        if (p.found != q.found) return false;
+        if (p.found && (p.x != q.x || p.y != q.y || p.area != q.area)) return false;
+    }
+    return true;
+}
+
+static void bench_pyramid(const char* path, CameraPipeline& ch)
+{
+    // every frame a full scan, every frame detected
+    bool tracking = laser_roi_tracking;
+    int threshold = change_threshold;
+    int level = pyramid_level;
+    laser_roi_tracking = false;
+    change_threshold = 0;
+
+    printf("pyramid (full-frame scans):\n");
+    std::vector<FrameResult> reference;
+    for (int l : {1, 2, 4}) {
+        pyramid_level = l;
+        if (ch.camera.open(std::make_unique<ReplaySource>(path, false), ch.frames) != EXIT_SUCCESS) break;
+        uint64_t refined_before = pyramid_stats.refined_pixels.load();
+        uint64_t fallbacks_before = pyramid_stats.fallbacks.load();
+
+        char name[32];
+        snprintf(name, sizeof(name), l == 1 ? "full resolution" : "level %d", l);
+        Timing capture{"  capture", {}}, detect{name, {}};
+        std::vector<FrameResult> results;
+        uint64_t found = 0;
+        while (!ch.camera.finished()) {
+            auto t0 = bench_clock::now();
+            ch.camera.capture(ch.frames, ch.detector.fullScanNext());
+            capture.ms.push_back(elapsed_ms(t0));
+            t0 = bench_clock::now();
+            ch.detector.detect(ch.frames, ch.points, ch.class_points);
+            detect.ms.push_back(elapsed_ms(t0));
+
+            FrameResult r;
+            ClassPoints points;
+            ch.class_points.read(points);
+            std::copy(points.points, points.points + MAX_COLOUR_CLASSES, r.points);
+            found += r.points[0].found;
+            results.push_back(r);
+        }
+        if (l == 1) reference = results;
+
+        uint64_t differ = 0;
+        for (size_t i = 0; i < results.size() && i < reference.size(); ++i) {
+            differ += !same_points(results[i], reference[i]);
+        }
+        uint64_t frames = std::max<size_t>(1, results.size());
+        detect.print();
+        capture.print();
+        printf("    found in %llu of %llu frames, %llu differ from full resolution, "
+               "%llu px refined/frame, %llu fallbacks\n",
+               (unsigned long long)found, (unsigned long long)results.size(), (unsigned long long)differ,
+               (unsigned long long)((pyramid_stats.refined_pixels.load() - refined_before) / frames),
+               (unsigned long long)(pyramid_stats.fallbacks.load() - fallbacks_before));
+    }
+
+    laser_roi_tracking = tracking;
+    change_threshold = threshold;
+    pyramid_level = level;
+}
+
+static void bench_throughput(const char* path, CameraPipeline& ch)
+{
+    if (ch.camera.open(std::make_unique<ReplaySource>(path, false), ch.frames) != EXIT_SUCCESS) return;
+
+    std::string name = detect_path == DETECT_BGR ? "capture+detect (bgr)"
+                     : detect_path == DETECT_LUT ? "capture+detect (lut)"
+                     : std::string("capture+detect (") + mask_kernel_name(selected_mask_kernel()) + ")";
+    Timing detect{name.c_str(), {}};
+    auto bench_start = bench_clock::now();
+    while (!ch.camera.finished()) {
+        auto t0 = bench_clock::now();
+        ch.camera.capture(ch.frames, ch.detector.fullScanNext());
+        ch.detector.detect(ch.frames, ch.points, ch.class_points);
+        detect.ms.push_back(elapsed_ms(t0));
+    }
+    double total_s = elapsed_ms(bench_start) / 1000.0;
+
+    printf("throughput over %zu frames: %.1f frames/s\n", detect.ms.size(), detect.ms.size() / total_s);
+    detect.print();
+
+    uint64_t frames = std::max<uint64_t>(1, laser_track_stats.frames.load());
+    printf("  tracking: %llu pixels scanned/frame, %llu windowed and %llu full frames, "
+           "%llu acquisitions, %llu losses\n",
+           (unsigned long long)(laser_track_stats.pixels_scanned.load() / frames),
+           (unsigned long long)laser_track_stats.window_frames.load(),
+           (unsigned long long)laser_track_stats.full_frames.load(),
+           (unsigned long long)laser_track_stats.acquisitions.load(),
+           (unsigned long long)laser_track_stats.losses.load());
+
+    uint64_t offered = change_gate_stats.frames.load();
+    uint64_t skipped = change_gate_stats.skipped.load();
+    if (change_threshold > 0 && offered) {
+        uint64_t detected = std::max<uint64_t>(1, offered - skipped);
+        double detect_ms = change_gate_stats.detect_ns.load() / 1e6 / detected;
+        printf("  change gate (threshold %d): %llu of %llu frames skipped (%.1f%%), %llu forced, "
+               "%.1f ms detector time saved, signatures %.3f ms/frame\n",
+               change_threshold, (unsigned long long)skipped, (unsigned long long)offered,
+               100.0 * skipped / offered, (unsigned long long)change_gate_stats.forced.load(),
+               skipped * detect_ms, change_gate_stats.signature_ns.load() / 1e6 / offered);
+    }
+}
+
+int main(int argc, char** argv)
+{
+    openlog("detect_bench", LOG_PID | LOG_PERROR, LOG_USER);
+
+    const char* usage = "usage: %s recording.yuyv [-c Config.json] [-d lut|yuyv|bgr] "
+                        "[-k scalar|sse4.1|avx2|neon] [-F] [-S largest|brightest|closest] [-W n] [-C cores] [-G n] [-P level]\n"
+                        "       %s -t N [recording.yuyv]\n";
+    const char* config_path = nullptr;
+    int verify_iterations = 0;
+    int throughput_workers = 1;
+    int opt;
+    while ((opt = getopt(argc, argv, "c:d:k:FS:W:C:G:P:t:")) != -1) {
+        switch (opt) {
+            case 'c': config_path = optarg; break;
+            case 'd':
+                if (!parse_detect_path(optarg, detect_path)) {
+                    fprintf(stderr, usage, argv[0], argv[0]);
+                    return EXIT_FAILURE;
+                }
+                break;
+            case 'k':
+                if (!select_mask_kernel(mask_kernel_from_name(optarg))) return EXIT_FAILURE;
+                break;
+            case 'F': laser_roi_tracking = false; break;
+            case 'W': throughput_workers = atoi(optarg); break;
+            case 'C':
+                if (!parse_core_list(optarg, stripe_cores)) {
+                    fprintf(stderr, usage, argv[0], argv[0]);
+                    return EXIT_FAILURE;
+                }
+                break;
+            case 'S':
+                if (!parse_blob_score(optarg, blob_score)) {
+                    fprintf(stderr, usage, argv[0], argv[0]);
+                    return EXIT_FAILURE;
+                }
+                break;
+            case 'G':
+                if (!parse_change_threshold(optarg, change_threshold)) {
+                    fprintf(stderr, usage, argv[0], argv[0]);
+                    return EXIT_FAILURE;
+                }
+                break;
+            case 'P':
+                pyramid_level = atoi(optarg);
+                if (pyramid_level != 1 && pyramid_level != 2 && pyramid_level != 4) {
+                    fprintf(stderr, usage, argv[0], argv[0]);
+                    return EXIT_FAILURE;
+                }
+                break;
+            case 't': verify_iterations = atoi(optarg); break;
+            default:
+                fprintf(stderr, usage, argv[0], argv[0]);
+                return EXIT_FAILURE;
+        }
+    }
+    // the kernel check runs on random frames, a recording only adds to them
+    if (verify_iterations > 0) {
+        return verify_kernels(optind < argc ? argv[optind] : nullptr, verify_iterations) ? EXIT_SUCCESS
+                                                                                          : EXIT_FAILURE;
+    }
+    if (optind >= argc) {
+        fprintf(stderr, usage, argv[0], argv[0]);
+        return EXIT_FAILURE;
+    }
+
+    if (config_path) {
+        if (!load_config(config_path)) return EXIT_FAILURE;
+    } else {
+        config_store.publish(HSVConfig{});
+    }
+    const HSVConfig& cfg = config_store.current()->hsv;
+
+    bench_mask_paths(argv[optind], cfg);
+    bench_blob_paths(argv[optind], cfg);
+    if (detect_path != DETECT_BGR) bench_stripes(argv[optind], cfg);
+    if (throughput_workers > 1) stripe_pool.configure(throughput_workers, stripe_cores);
+    // the bench calls the capture service itself, back to back, one frame
+    // each
+    capture_wake = CAPTURE_PERIODIC;
+    CameraPipeline channels(0);
+    bench_throughput(argv[optind], channels);
+    // after the throughput run, which reports the cumulative tracking stats
+    if (detect_path == DETECT_LUT) bench_pyramid(argv[optind], channels);
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,123 @@
+/***************************************************************
+ * File: detect_stripes.cpp
+ * Description: Stripe worker pool for the laser detector.
+ ***************************************************************/
+
+#include "detect_stripes.hpp"
+#include "laser_mask.hpp"
+
+#include <cstdlib>
+#include <pthread.h>
+#include <sched.h>
+#include <syslog.h>
+
+StripePool stripe_pool;
+
+bool parse_core_list(const char* list, std::vector<int>& cores)
+{
+    cores.clear();
+    const char* p = list;
+    while (*p) {
+        char* end;
+        long core = strtol(p, &end, 10);
+        if (end == p || core < 0 || core >= CPU_SETSIZE) return false;
+        cores.push_back(int(core));
+        p = *end == ',' ? end + 1 : end;
+        if (*end && *end != ',') return false;
+    }
+    return !cores.empty();
+}
+
+StripePool::~StripePool()
+{
+    stop();
+}
+
+void StripePool::configure(int workers, const std::vector<int>& cores, int priority)
+{
+    stop();
+    _workers = std::max(1, std::min(workers, STRIPE_MAX_WORKERS));
+    if (_workers > 1 && cores.empty()) {
+        syslog(LOG_ERR, "Stripes: no cores for helper threads, detecting on one core");
+        _workers = 1;
+    }
+
+    for (int i = 1; i < _workers; ++i) {
+        _go[i] = std::make_unique<std::binary_semaphore>(0);
+        _helpers[i] = std::jthread([this, i](std::stop_token stop) { _helperLoop(i, stop); });
+
+        int core = cores[(i - 1) % cores.size()];
+        cpu_set_t cpuset;
+        CPU_ZERO(&cpuset);
+        CPU_SET(core, &cpuset);
+        if (pthread_setaffinity_np(_helpers[i].native_handle(), sizeof(cpu_set_t), &cpuset) != 0) {
+            syslog(LOG_ERR, "Stripes: failed to pin helper %d to core %d", i, core);
+        }
+        struct sched_param param{};
+        param.sched_priority = priority;
+        if (pthread_setschedparam(_helpers[i].native_handle(), SCHED_FIFO, &param) != 0) {
+            syslog(LOG_WARNING, "Stripes: helper %d stays SCHED_OTHER (no RT permission)", i);
+        }
+    }
+    syslog(LOG_INFO, "Stripes: %d worker(s)", _workers);
+}
+
+void StripePool::stop()
+{
+    for (int i = 1; i < STRIPE_MAX_WORKERS; ++i) {
+        if (!_helpers[i].joinable()) continue;
+        _helpers[i].request_stop();
+        _go[i]->release();
+        _helpers[i].join();
+    }
+    _workers = 1;
+}
+
+int StripePool::stripes_for(int rows) const
+{
+    return std::max(1, std::min(_workers, rows / STRIPE_MIN_ROWS));
+}
+
+void StripePool::_helperLoop(int index, std::stop_token stop)
+{
+    while (true) {
+        _go[index]->acquire();
+        if (stop.stop_requested()) return;
+        _stripe(index);
+        _done.release();
+    }
+}
+
+void StripePool::_stripe(int index)
+{
+    int r0 = _row0[index];
+    int rows = _row0[index + 1] - r0;
+    const uint8_t* yuyv = _job.yuyv + size_t(r0) * _job.stride;
+
+    // a header over this stripe's rows of the shared mask; the builders'
+    // create() is a no-op because size and type already match
+    cv::Mat mask = (*_job.mask)(cv::Rect(0, r0, _job.width, rows));
+    if (_job.lut) {
+        mask_from_lut(yuyv, _job.width, rows, _job.stride, *_job.lut, mask);
+    } else {
+        mask_from_yuyv(yuyv, _job.width, rows, _job.stride, *_job.thresholds, mask);
+    }
+
+    // every component is kept, the size filter runs after the merge
+    _labellers[index].label(mask, yuyv, _job.stride, 0);
+}
+
+void StripePool::run(const StripeJob& job, uint32_t min_area, std::vector<Blob>& blobs)
+{
+    _job = job;
+    _job.mask->create(job.height, job.width, CV_8UC1);
+
+    _stripes = stripes_for(job.height);
+    for (int i = 0; i <= _stripes; ++i) _row0[i] = job.height * i / _stripes;
+
+    for (int i = 1; i < _stripes; ++i) _go[i]->release();
+    _stripe(0);
+    for (int i = 1; i < _stripes; ++i) _done.acquire();
+
+    merge_stripe_blobs(_labellers, _row0, _stripes, min_area, blobs);
+}
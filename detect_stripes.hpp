@@ -0,0 +1,79 @@
+/***************************************************************
+ * File: detect_stripes.hpp
+ * Description: Band-parallel mask building and blob labelling. The
+ *              search window is cut into horizontal stripes; the
+ *              detector thread does the first one and a small pool of
+ *              pinned helper threads on the otherwise idle cores does
+ *              the rest. Each stripe writes its rows of the shared mask
+ *              and labels them on its own; the partial blobs are merged
+ *              across stripe borders by merge_stripe_blobs().
+ ***************************************************************/
+
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <semaphore>
+#include <thread>
+#include <vector>
+#include <opencv2/opencv.hpp>
+#include "blob_label.hpp"
+#include "colour_lut.hpp"
+#include "laser_mask.hpp"
+#include "red_laser_service.hpp"
+
+#define STRIPE_MAX_WORKERS 4
+
+// Below this many rows per stripe the hand-off costs more than it saves,
+// small tracking windows are done by the detector thread alone
+#define STRIPE_MIN_ROWS 32
+
+// Helper threads run at the detector's priority so the stripes finish together
+#define STRIPE_PRIORITY 97
+
+// What one frame's stripes work on
+struct StripeJob {
+    const uint8_t* yuyv;        // top-left of the search window
+    int width, height, stride;
+    const ColourLut* lut;       // nullptr: exact YUYV kernel with `thresholds`
+    const MaskThresholds* thresholds;
+    cv::Mat* mask;              // window-sized CV_8UC1, rows are shared out
+};
+
+class StripePool {
+public:
+    ~StripePool();
+
+    // `workers` stripes per frame (1 = detector thread only); helpers are
+    // pinned round-robin to `cores`. Restarts the helpers if running.
+    void configure(int workers, const std::vector<int>& cores, int priority = STRIPE_PRIORITY);
+    void stop();
+
+    int workers() const { return _workers; }
+
+    // Stripes a window of `rows` rows would be split into
+    int stripes_for(int rows) const;
+
+    // Build the mask and the blobs for `job`, blocks until every stripe is done
+    void run(const StripeJob& job, uint32_t min_area, std::vector<Blob>& blobs);
+
+private:
+    void _helperLoop(int index, std::stop_token stop);
+    void _stripe(int index);
+
+    int _workers = 1;
+    int _stripes = 1;
+    StripeJob _job{};
+    int _row0[STRIPE_MAX_WORKERS + 1] = {};
+    BlobLabeller _labellers[STRIPE_MAX_WORKERS];
+
+    std::unique_ptr<std::binary_semaphore> _go[STRIPE_MAX_WORKERS];
+    std::counting_semaphore<> _done{0};
+    std::jthread _helpers[STRIPE_MAX_WORKERS];
+};
+
+extern StripePool stripe_pool;
+
+// "0,2,3" -> {0, 2, 3}, false on a malformed list
+bool parse_core_list(const char* list, std::vector<int>& cores);
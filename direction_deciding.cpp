@@ -1,109 +1,125 @@
-/******************************************************************************
- * File Name    : direction_deciding.cpp
- * Description  : This file contains the logic for Service 3, responsible for
- *                determining the robot's movement direction and speed based 
- *                on the position of the detected red laser dot.
- * 
- *                The service computes movement commands such as FORWARD, LEFT,
- *                RIGHT, or STOP, and assigns speed levels depending on the
- *                vertical distance of the laser from the robot.
- *
- * Authors      : Lokesh Senthil Kumar
- ******************************************************************************/
-
- #include "red_laser_service.hpp"
- #include <syslog.h>
- #include "direction_deciding.hpp"
- #include <optional>  
- #include "watchdog.hpp"
- 
- // Shared variable to store the most recently computed movement command
- std::optional<MovementCommand> latest_cmd;
- std::mutex cmd_mutex;
- std::atomic<bool> cmd_available{false};
- 
- /**
-  * @brief Determines the robot's movement direction and speed based on the 
-  *        given position of the red laser dot.
-  * 
-  * @param pos - The 2D coordinates of the red laser dot.
-  * @return MovementCommand - The decided movement direction and speed level.
-  */
- MovementCommand service3_decide_direction(Point2D pos) {
-     MovementCommand cmd;
- 
-     bool isLeft   = (pos.x < 200);
-     bool isCenter = (pos.x >= 200) && (pos.x <= 450) && (pos.y <= 480);
-     bool isRight  = (pos.x > 450);
-     bool isTop    = (pos.y < 400);
-     bool isBottom = (pos.y > 400);
- 
-     if (isLeft && (isTop || isBottom)) {
-         cmd.dir = LEFT;
-     }
-     else if (isRight && (isTop || isBottom)) {
-         cmd.dir = RIGHT;
-     }
-     else if (isCenter) {
-         cmd.dir = FORWARD;
-     }
-     else {
-         cmd.dir = STOP;
-     }
- 
-     // Assign speed level based on how far the red dot is from the robot (y-axis)
-     if (pos.y < 160) {
-         cmd.speed_level = 3; // Fast
-     }
-     else if (pos.y <= 320) {
-         cmd.speed_level = 2; // Medium
-     }
-     else {
-         cmd.speed_level = 1; // Slow
-     }
- 
-     return cmd;
- }
- 
- /**
-  * @brief Main thread function for Service 3.
-  *        Reads the latest red laser position, calculates direction & speed,
-  *        updates the global movement command, and logs the decision.
-  */
- void service3_thread() {
-     if (!point_available.load(std::memory_order_acquire)) {
-        service3_ok = true;
-         return;
-     }
- 
-     std::optional<Point2D> pointer_location;
-     {
-         std::lock_guard<std::mutex> lock(point_mutex);
-         pointer_location = latest_laser_point;
-         point_available.store(false, std::memory_order_release);
-     }
- 
-     if (!pointer_location) return;
- 
-     auto cmd = service3_decide_direction(*pointer_location);
-     {
-         std::lock_guard lock(cmd_mutex);
-         latest_cmd = cmd;
-         cmd_available.store(true, std::memory_order_release);
-     }
- 
-     const char* dirStr = "STOP";
-     switch (cmd.dir) {
-         case FORWARD:                 dirStr = "FORWARD";        break;
-         case LEFT:                    dirStr = "LEFT";           break;
-         case RIGHT:                   dirStr = "RIGHT";          break;
-         case STOP: default:           dirStr = "STOP";            break;
-     }
- 
-     syslog(LOG_INFO,
-            "Service 3 → Direction: %s | Speed Level: %d | Position: (%d, %d)",
-            dirStr, cmd.speed_level, pointer_location->x, pointer_location->y);
- 
-     service3_ok = true; // Signal to watchdog that this service is alive
- }
- 
+/******************************************************************************
+ * File Name    : direction_deciding.cpp
+ * Description  : This file contains the logic for Service 3, responsible for
+ *                determining the robot's movement direction and speed based 
+ *                on the position of the detected red laser dot.
+ * 
+ *                The service computes movement commands such as FORWARD, LEFT,
+ *                RIGHT, or STOP, and assigns speed levels depending on the
+ *                vertical distance of the laser from the robot.
+ *
+ * Authors      : Lokesh Senthil Kumar
+ ******************************************************************************/
+
+ #include "red_laser_service.hpp"
+ #include <syslog.h>
+ #include "direction_deciding.hpp"
+ #include <optional>  
+ #include "watchdog.hpp"
+ #include "laser_tracker.hpp"
+ #include <algorithm>
+ 
+ 
+ /**
+  * @brief Determines the robot's movement direction and speed based on the 
+  *        given position of the red laser dot.
+  * 
+  * @param pos - The 2D coordinates of the red laser dot.
+  * @param map - The direction and speed bands to apply.
+  * @return MovementCommand - The decided movement direction and speed level.
+  */
+ MovementCommand service3_decide_direction(Point2D pos, const DecisionMap& map) {
+     MovementCommand cmd;
+     cmd.config_behave = pos.behav;
+     cmd.capture_ns = pos.t_ns;
+     cmd.trace = pos.trace;
+ 
+     bool isLeft   = (pos.x < map.left_x);
+     bool isCenter = (pos.x >= map.left_x) && (pos.x <= map.right_x) && (pos.y <= map.bottom_y);
+     bool isRight  = (pos.x > map.right_x);
+     bool isTop    = (pos.y < map.horizon_y);
+     bool isBottom = (pos.y > map.horizon_y);
+ 
+     if (isLeft && (isTop || isBottom)) {
+         cmd.dir = LEFT;
+     }
+     else if (isRight && (isTop || isBottom)) {
+         cmd.dir = RIGHT;
+     }
+     else if (isCenter) {
+         cmd.dir = FORWARD;
+     }
+     else {
+         cmd.dir = STOP;
+     }
+ 
+     // Assign speed level based on how far the red dot is from the robot (y-axis)
+     if (pos.y < map.fast_y) {
+         cmd.speed_level = 3; // Fast
+     }
+     else if (pos.y <= map.medium_y) {
+         cmd.speed_level = 2; // Medium
+     }
+     else {
+         cmd.speed_level = 1; // Slow
+     }
+ 
+     return cmd;
+ }
+ 
+ /**
+  * @brief Main thread function for Service 3.
+  *        Reads the latest red laser position, folds it into the tracker,
+  *        calculates direction & speed from where the dot will be when the
+  *        command takes effect, updates the global movement command, and
+  *        logs the decision.
+  */
+ void service3_thread(Channel<Point2D>& points, Channel<TrackState>& track_out,
+                      Channel<MovementCommand>& commands) {
+     // taken every period, point or not, so old snapshots can be freed
+     const ConfigSnapshot* snapshot = config_store.acquire(CONFIG_READER_DECIDE);
+
+     Point2D pointer_location;
+     if (!points.read(pointer_location) || !snapshot) {
+        service3_ok = true;
+         return;
+     }
+ 
+     // steer toward where the dot will be once the motors act on this
+     // command, the measurement is already one pipeline latency old
+     // the change gate hands back the same point, with its old capture
+     // time, while the scene stands still; only a new one is a latency sample
+     uint64_t now = steady_ns();
+     bool fresh = laser_tracker.update(pointer_location);
+     if (fresh) note_decision_latency(now - pointer_location.t_ns);
+     TrackState track = laser_tracker.predict(std::max(now, pointer_location.t_ns + pipeline_latency_ns()));
+     track_out.publish(track);
+     Point2D target = pointer_location;
+     if (track.valid && track.confidence >= TRACK_MIN_CONFIDENCE) {
+         target.x = track.px;
+         target.y = track.py;
+     }
+ 
+     auto cmd = service3_decide_direction(target, snapshot->decision);
+     if (!fresh) cmd.capture_ns = 0;
+     cmd.trace.decided_ns = steady_ns();
+     commands.publish(cmd);
+     trace_record(cmd.trace);
+ 
+     const char* dirStr = "STOP";
+     switch (cmd.dir) {
+         case FORWARD:                 dirStr = "FORWARD";        break;
+         case LEFT:                    dirStr = "LEFT";           break;
+         case RIGHT:                   dirStr = "RIGHT";          break;
+         case STOP: default:           dirStr = "STOP";            break;
+     }
+ 
+     syslog(LOG_INFO,
+            "Service 3 → Direction: %s | Speed Level: %d | Position: (%.1f, %.1f) -> (%.1f, %.1f) | "
+            "v (%.0f, %.0f) px/s | conf %.2f",
+            dirStr, cmd.speed_level, pointer_location.x, pointer_location.y, target.x, target.y,
+            track.vx, track.vy, track.confidence);
+ 
+     service3_ok = true; // Signal to watchdog that this service is alive
+ }
+ 
@@ -0,0 +1,81 @@
+/***************************************************************
+ * File: frame_change.cpp
+ * Description: Tile luma signatures and the change gate statistics.
+ ***************************************************************/
+
+#include "frame_change.hpp"
+
+#include <cstdlib>
+#include <cstring>
+#include <syslog.h>
+
+int change_threshold = CHANGE_THRESHOLD_DEFAULT;
+ChangeGateStats change_gate_stats;
+
+bool parse_change_threshold(const char* text, int& threshold)
+{
+    char* end = nullptr;
+    long value = strtol(text, &end, 10);
+    if (end == text || *end != '\0' || value < 0 || value > CHANGE_THRESHOLD_MAX) return false;
+    threshold = int(value);
+    return true;
+}
+
+void compute_frame_signature(const uint8_t* yuyv, int width, int height, int stride,
+                             FrameSignature& sig)
+{
+    sig.width = width;
+    sig.height = height;
+    sig.tiles_x = (width + CHANGE_TILE_SIZE - 1) / CHANGE_TILE_SIZE;
+    sig.tiles_y = (height + CHANGE_TILE_SIZE - 1) / CHANGE_TILE_SIZE;
+    sig.valid = sig.tiles_x * sig.tiles_y <= CHANGE_MAX_TILES;
+    if (!sig.valid) return;
+
+    memset(sig.luma, 0, sizeof(uint32_t) * sig.tiles_x * sig.tiles_y);
+    for (int y = 0; y < height; y += CHANGE_SAMPLE_ROWS) {
+        const uint8_t* row = yuyv + size_t(y) * stride;
+        uint32_t* tiles = sig.luma + (y / CHANGE_TILE_SIZE) * sig.tiles_x;
+        for (int x0 = 0; x0 < width; x0 += CHANGE_TILE_SIZE) {
+            int x1 = x0 + CHANGE_TILE_SIZE < width ? x0 + CHANGE_TILE_SIZE : width;
+            // Y U Y V: masking 8 bytes keeps four lumas in 16 bit lanes,
+            // a tile row (32 pixels) cannot overflow them
+            uint64_t lanes = 0;
+            int x = x0;
+            for (; x + 4 <= x1; x += 4) {
+                uint64_t w;
+                memcpy(&w, row + x * 2, sizeof(w));
+                lanes += w & 0x00ff00ff00ff00ffull;
+            }
+            uint32_t sum = uint32_t((lanes & 0xffff) + ((lanes >> 16) & 0xffff) +
+                                    ((lanes >> 32) & 0xffff) + (lanes >> 48));
+            for (; x < x1; ++x) sum += row[x * 2];
+            tiles[x0 / CHANGE_TILE_SIZE] += sum;
+        }
+    }
+}
+
+bool signature_changed(const FrameSignature& a, const FrameSignature& b, int threshold)
+{
+    if (!a.valid || !b.valid || a.width != b.width || a.height != b.height) return true;
+    int tiles = a.tiles_x * a.tiles_y;
+    for (int i = 0; i < tiles; ++i) {
+        if (abs(int(a.luma[i]) - int(b.luma[i])) > threshold) return true;
+    }
+    return false;
+}
+
+void log_change_gate_stats()
+{
+    uint64_t frames = change_gate_stats.frames.load();
+    if (frames == 0 || change_threshold <= 0) return;
+    uint64_t skipped = change_gate_stats.skipped.load();
+    uint64_t detected = frames - skipped;
+    double detect_ms = detected ? change_gate_stats.detect_ns.load() / 1e6 / detected : 0.0;
+    double signature_ms = change_gate_stats.signature_ns.load() / 1e6;
+    syslog(LOG_INFO, "Change Gate Stats (threshold %d):", change_threshold);
+    syslog(LOG_INFO, "  Frames skipped        : %llu of %llu (%.1f%%), %llu forced detections",
+           (unsigned long long)skipped, (unsigned long long)frames, 100.0 * skipped / frames,
+           (unsigned long long)change_gate_stats.forced.load());
+    syslog(LOG_INFO, "  Detector time saved   : %.1f ms (%.3f ms / detected frame), signatures cost %.1f ms",
+           skipped * detect_ms, detect_ms, signature_ms);
+}
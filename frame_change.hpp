@@ -0,0 +1,65 @@
+/***************************************************************
+ * File: frame_change.hpp
+ * Description: Per-tile luma signature of a frame, computed by the
+ *              capture service right after VIDIOC_DQBUF. The detector
+ *              compares it with the signature of the last frame it
+ *              actually processed and skips frames in which no tile
+ *              moved by more than the configured threshold, reusing
+ *              the previously published point.
+ *
+ *              The signature sums every pixel of every fourth row, so
+ *              only a quarter of the frame is read and any blob four
+ *              rows tall or more lands on the samples. A 640x480 frame
+ *              is 300 tiles of 32x32 pixels, 256 samples each.
+ ***************************************************************/
+
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+
+#define CHANGE_TILE_SIZE   32
+#define CHANGE_SAMPLE_ROWS 4
+#define CHANGE_MAX_TILES   1200     // 40x30 tiles: up to 1280x960
+// a tile changed when its sampled luma sum moved by more than this, i.e.
+// half a level on average over a full tile, or one sample jumping by 128
+#define CHANGE_THRESHOLD_DEFAULT 128
+// no tile's sampled luma sum can move by more than this
+#define CHANGE_THRESHOLD_MAX (CHANGE_TILE_SIZE * (CHANGE_TILE_SIZE / CHANGE_SAMPLE_ROWS) * 255)
+// however still the scene, detect at least once per this many frames
+#define CHANGE_MAX_SKIP 30
+
+struct FrameSignature {
+    bool valid = false;
+    int width = 0, height = 0;
+    int tiles_x = 0, tiles_y = 0;
+    uint32_t luma[CHANGE_MAX_TILES];   // sampled luma sum per tile, row-major
+};
+
+// Sample the Y bytes of a packed YUYV frame into `sig`. Frames with more
+// tiles than CHANGE_MAX_TILES get no signature (valid == false).
+void compute_frame_signature(const uint8_t* yuyv, int width, int height, int stride,
+                             FrameSignature& sig);
+
+// True if any tile of `a` and `b` differs by more than `threshold`, or the
+// two cannot be compared (missing signature or different geometry)
+bool signature_changed(const FrameSignature& a, const FrameSignature& b, int threshold);
+
+// sampled luma sum change that marks a tile as changed, 0 = gate off
+extern int change_threshold;
+
+// a whole number 0..CHANGE_THRESHOLD_MAX, false otherwise
+bool parse_change_threshold(const char* text, int& threshold);
+
+struct ChangeGateStats {
+    std::atomic<uint64_t> frames{0};           // frames offered to the detector
+    std::atomic<uint64_t> skipped{0};          // reused the previous result
+    std::atomic<uint64_t> forced{0};           // unchanged, detected anyway (CHANGE_MAX_SKIP)
+    std::atomic<uint64_t> signature_ns{0};     // capture side cost
+    std::atomic<uint64_t> detect_ns{0};        // time spent in frames that were detected
+};
+extern ChangeGateStats change_gate_stats;
+
+// Log skip rate and the detector time saved (skipped frames at the mean
+// cost of a detected one) minus the signature cost
+void log_change_gate_stats();
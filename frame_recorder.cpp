@@ -0,0 +1,197 @@
+/***************************************************************
+ * File: frame_recorder.cpp
+ * Description: Writer side of the field recorder.
+ ***************************************************************/
+
+#include "frame_recorder.hpp"
+
+#include <algorithm>
+#include <cerrno>
+#include <chrono>
+#include <cstdlib>
+#include <cstring>
+#include <fcntl.h>
+#include <pthread.h>
+#include <sched.h>
+#include <sys/mman.h>
+#include <syslog.h>
+#include <unistd.h>
+
+FrameRecorder frame_recorder;
+
+FrameRecorder::~FrameRecorder()
+{
+    stop();
+}
+
+int FrameRecorder::open(const char* path, uint32_t capacity, const FrameFormat& fmt)
+{
+    if (fmt.frame_bytes == 0 || capacity == 0) {
+        syslog(LOG_ERR, "Recorder: nothing to record (no frame format or capacity)");
+        return EXIT_FAILURE;
+    }
+
+    uint64_t page = sysconf(_SC_PAGESIZE);
+    uint64_t data_offset = recording_data_offset(capacity, page);
+    _map_length = data_offset + uint64_t(capacity) * fmt.frame_bytes;
+
+    _fd = ::open(path, O_RDWR | O_CREAT | O_TRUNC, 0644);
+    if (_fd < 0) {
+        syslog(LOG_ERR, "Recorder: cannot create %s: %s", path, strerror(errno));
+        return EXIT_FAILURE;
+    }
+
+    // reserve the blocks now so the writer never waits on allocation
+    int err = posix_fallocate(_fd, 0, _map_length);
+    if (err != 0) {
+        syslog(LOG_ERR, "Recorder: cannot preallocate %zu bytes: %s", _map_length, strerror(err));
+        return EXIT_FAILURE;
+    }
+
+    void* map = mmap(NULL, _map_length, PROT_READ | PROT_WRITE, MAP_SHARED, _fd, 0);
+    if (map == MAP_FAILED) {
+        syslog(LOG_ERR, "Recorder: mmap failed: %s", strerror(errno));
+        return EXIT_FAILURE;
+    }
+    _map = static_cast<uint8_t*>(map);
+    madvise(_map, _map_length, MADV_SEQUENTIAL);
+
+    _header = reinterpret_cast<RecordingHeader*>(_map);
+    _index = reinterpret_cast<RecordingIndexEntry*>(_map + sizeof(RecordingHeader));
+    std::memset(_header, 0, sizeof(RecordingHeader));
+    std::memcpy(_header->magic, RECORDING_MAGIC, sizeof(_header->magic));
+    _header->version = RECORDING_VERSION;
+    _header->pixelformat = fmt.pixelformat;
+    _header->width = fmt.width;
+    _header->height = fmt.height;
+    _header->stride = fmt.stride;
+    _header->frame_bytes = fmt.frame_bytes;
+    _header->capacity = capacity;
+    _header->count = 0;
+    _header->data_offset = data_offset;
+
+    syslog(LOG_INFO, "Recorder: %s preallocated for %u frames (%zu MB)", path, capacity,
+           _map_length >> 20);
+    return EXIT_SUCCESS;
+}
+
+void FrameRecorder::start(int cpu)
+{
+    if (!_map) return;
+    _active = true;
+    _writer = std::jthread([this](std::stop_token stop) { _writerLoop(stop); });
+
+    cpu_set_t cpuset;
+    CPU_ZERO(&cpuset);
+    CPU_SET(cpu, &cpuset);
+    if (pthread_setaffinity_np(_writer.native_handle(), sizeof(cpu_set_t), &cpuset) != 0) {
+        syslog(LOG_ERR, "Recorder: failed to pin writer thread to core %d", cpu);
+    }
+    struct sched_param param{};
+    param.sched_priority = 0;
+    pthread_setschedparam(_writer.native_handle(), SCHED_OTHER, &param);
+}
+
+void FrameRecorder::stop()
+{
+    if (!_map) return;
+    _active = false;
+    if (_writer.joinable()) {
+        _writer.request_stop();
+        _pending.release();
+        _writer.join();
+    }
+
+    // drop anything the writer did not get to
+    while (_head.load() != _tail.load()) {
+        _queue[_head.load() % RECORDER_DEPTH].reset();
+        _head.fetch_add(1);
+    }
+
+    msync(_map, _map_length, MS_SYNC);
+    munmap(_map, _map_length);
+    close(_fd);
+    _map = nullptr;
+    _fd = -1;
+    logStats();
+}
+
+bool FrameRecorder::submit(const FrameHandle& frame)
+{
+    if (!active()) return false;
+    _submitted.fetch_add(1, std::memory_order_relaxed);
+
+    uint64_t tail = _tail.load(std::memory_order_relaxed);
+    if (tail - _head.load(std::memory_order_acquire) >= RECORDER_DEPTH) {
+        _dropped_busy.fetch_add(1, std::memory_order_relaxed);
+        return false;
+    }
+
+    // copying the handle only bumps the slot reference count
+    _queue[tail % RECORDER_DEPTH] = frame;
+    _tail.store(tail + 1, std::memory_order_release);
+    _pending.release();
+    return true;
+}
+
+void FrameRecorder::_writerLoop(std::stop_token stop)
+{
+    uint64_t reported_drops = 0;
+    auto last_report = std::chrono::steady_clock::now();
+
+    while (!stop.stop_requested()) {
+        _pending.acquire();
+
+        uint64_t head = _head.load(std::memory_order_relaxed);
+        while (head != _tail.load(std::memory_order_acquire)) {
+            FrameHandle& frame = _queue[head % RECORDER_DEPTH];
+            _write(frame);
+            // the camera buffer goes back to the driver here if capture and
+            // detection are already done with it
+            frame.reset();
+            _head.store(++head, std::memory_order_release);
+        }
+
+        // report drops from this thread, never from the capture service
+        uint64_t drops = _dropped_busy.load(std::memory_order_relaxed);
+        auto now = std::chrono::steady_clock::now();
+        if (drops != reported_drops && now - last_report > std::chrono::seconds(1)) {
+            syslog(LOG_WARNING, "Recorder: writer behind, %llu frames dropped so far",
+                   (unsigned long long)drops);
+            reported_drops = drops;
+            last_report = now;
+        }
+    }
+}
+
+void FrameRecorder::_write(const FrameHandle& frame)
+{
+    uint32_t n = _header->count;
+    if (n >= _header->capacity) {
+        if (_dropped_full.fetch_add(1, std::memory_order_relaxed) == 0) {
+            syslog(LOG_WARNING, "Recorder: file full after %u frames", n);
+        }
+        return;
+    }
+
+    size_t bytes = std::min<size_t>(frame.bytesused(), _header->frame_bytes);
+    std::memcpy(_map + _header->data_offset + uint64_t(n) * _header->frame_bytes, frame.data(), bytes);
+
+    const timeval& ts = frame.timestamp();
+    _index[n].timestamp_us = uint64_t(ts.tv_sec) * 1000000u + ts.tv_usec;
+    _index[n].sequence = frame.sequence();
+    _index[n].bytesused = bytes;
+
+    // publish the frame only after its data and index entry are in place
+    __atomic_store_n(&_header->count, n + 1, __ATOMIC_RELEASE);
+    _written.fetch_add(1, std::memory_order_relaxed);
+}
+
+void FrameRecorder::logStats() const
+{
+    syslog(LOG_INFO, "Recorder Stats:");
+    syslog(LOG_INFO, "  Frames submitted      : %llu", (unsigned long long)_submitted.load());
+    syslog(LOG_INFO, "  Frames written        : %llu", (unsigned long long)_written.load());
+    syslog(LOG_INFO, "  Dropped, writer behind: %llu", (unsigned long long)_dropped_busy.load());
+    syslog(LOG_INFO, "  Dropped, file full    : %llu", (unsigned long long)_dropped_full.load());
+}
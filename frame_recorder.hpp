@@ -0,0 +1,74 @@
+/***************************************************************
+ * File: frame_recorder.hpp
+ * Description: Field recorder for raw YUYV frames. The capture
+ *              service only hands a FrameHandle to the recorder; a
+ *              non-RT writer thread pinned away from the pipeline core
+ *              copies the frame and its V4L2 timestamp/sequence into a
+ *              preallocated, memory-mapped recording file
+ *              (recording_format.hpp). When the writer falls behind the
+ *              frame is dropped and counted, capture never blocks.
+ ***************************************************************/
+
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <semaphore>
+#include <thread>
+#include "frame_ring.hpp"
+#include "frame_source.hpp"
+#include "recording_format.hpp"
+
+// Frames the recorder may hold at once; counted in
+// capture_buffers_needed()
+#define RECORDER_DEPTH 1
+
+// Core the writer thread runs on, away from the RT services on core 1
+#define RECORDER_CPU 3
+
+class FrameRecorder {
+public:
+    ~FrameRecorder();
+
+    // Create and preallocate `path` for `capacity` frames of format `fmt`
+    int open(const char* path, uint32_t capacity, const FrameFormat& fmt);
+
+    // Start the writer thread on `cpu` (SCHED_OTHER)
+    void start(int cpu = RECORDER_CPU);
+
+    // Flush the index, stop the writer and unmap the file
+    void stop();
+
+    bool active() const { return _active.load(std::memory_order_relaxed); }
+
+    // Called from the capture service: pointer hand-off only, never blocks.
+    // Returns false and counts a drop if the writer is still busy.
+    bool submit(const FrameHandle& frame);
+
+    void logStats() const;
+
+private:
+    void _writerLoop(std::stop_token stop);
+    void _write(const FrameHandle& frame);
+
+    int _fd = -1;
+    uint8_t* _map = nullptr;
+    size_t _map_length = 0;
+    RecordingHeader* _header = nullptr;
+    RecordingIndexEntry* _index = nullptr;
+
+    // single producer (capture) / single consumer (writer) ring of handles
+    FrameHandle _queue[RECORDER_DEPTH];
+    std::atomic<uint64_t> _head{0};
+    std::atomic<uint64_t> _tail{0};
+    std::counting_semaphore<> _pending{0};
+    std::jthread _writer;
+    std::atomic<bool> _active{false};
+
+    std::atomic<uint64_t> _submitted{0};
+    std::atomic<uint64_t> _written{0};
+    std::atomic<uint64_t> _dropped_busy{0};   // writer behind
+    std::atomic<uint64_t> _dropped_full{0};   // file capacity reached
+};
+
+extern FrameRecorder frame_recorder;
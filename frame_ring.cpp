@@ -0,0 +1,77 @@
+/***************************************************************
+ * File: frame_ring.cpp
+ * Description: Reference counting for frame slots handed out by the
+ *              capture service.
+ ***************************************************************/
+
+#include "frame_ring.hpp"
+#include "frame_source.hpp"
+
+#include <syslog.h>
+#include <utility>
+
+FrameCopyStats frame_copy_stats;
+
+FrameHandle::FrameHandle(FrameSlot* slot) : _slot(slot)
+{
+    if (_slot) _slot->refs.store(1, std::memory_order_relaxed);
+}
+
+FrameHandle::FrameHandle(const FrameHandle& other) : _slot(other._slot)
+{
+    if (_slot) _slot->refs.fetch_add(1, std::memory_order_relaxed);
+}
+
+FrameHandle::FrameHandle(FrameHandle&& other) noexcept : _slot(std::exchange(other._slot, nullptr))
+{
+}
+
+FrameHandle& FrameHandle::operator=(const FrameHandle& other)
+{
+    if (this != &other) {
+        FrameHandle tmp(other);
+        std::swap(_slot, tmp._slot);
+    }
+    return *this;
+}
+
+FrameHandle& FrameHandle::operator=(FrameHandle&& other) noexcept
+{
+    if (this != &other) {
+        reset();
+        _slot = std::exchange(other._slot, nullptr);
+    }
+    return *this;
+}
+
+FrameHandle::~FrameHandle()
+{
+    reset();
+}
+
+void FrameHandle::reset()
+{
+    FrameSlot* slot = std::exchange(_slot, nullptr);
+    if (!slot) return;
+
+    // last consumer gives the buffer back to the driver
+    if (slot->refs.fetch_sub(1, std::memory_order_acq_rel) == 1 && slot->source) {
+        slot->source->release(*slot);
+    }
+}
+
+void log_frame_copy_stats()
+{
+    uint64_t frames = frame_copy_stats.frames_detected.load();
+    if (frames == 0) {
+        syslog(LOG_INFO, "Frame hand-off: no frames detected");
+        return;
+    }
+    syslog(LOG_INFO, "Frame hand-off Stats:");
+    syslog(LOG_INFO, "  Frames captured       : %llu",
+           (unsigned long long)frame_copy_stats.frames_captured.load());
+    syslog(LOG_INFO, "  Frames detected       : %llu", (unsigned long long)frames);
+    syslog(LOG_INFO, "  Bytes copied / frame  : %llu (legacy path: %llu)",
+           (unsigned long long)(frame_copy_stats.bytes_copied.load() / frames),
+           (unsigned long long)(frame_copy_stats.bytes_copied_legacy.load() / frames));
+}
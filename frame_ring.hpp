@@ -0,0 +1,109 @@
+/***************************************************************
+ * File: frame_ring.hpp
+ * Description: Reference-counted frame slots layered on top of the
+ *              frame source buffers (V4L2 mmap buffers on the robot).
+ *              A dequeued buffer is handed from the capture service to
+ *              its consumers by handle; the buffer goes back to its
+ *              source (VIDIOC_QBUF) only when the last handle referring
+ *              to it is released.
+ ***************************************************************/
+
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+#include <linux/videodev2.h>
+#include "frame_change.hpp"
+
+class FrameSource;
+
+// Class mask decimated to level x level blocks: a block has the class bits
+// of the one YUYV macropixel (two pixels) at its top left corner, so a dot
+// at least level + 1 pixels across always hits one
+struct CoarseMask {
+    bool valid = false;
+    int level = 0;
+    int width = 0, height = 0;      // in blocks, partial edge blocks included
+    uint64_t lut_generation = 0;    // colour table the mask was sampled with
+    std::vector<uint8_t> bits;
+
+    // Room for the finest level, so sampling never allocates
+    void reserve(int frame_width, int frame_height)
+    {
+        bits.reserve(size_t((frame_width + 1) / 2) * ((frame_height + 1) / 2));
+    }
+};
+
+// One slot per frame buffer, owned by the FrameSource that fills it
+struct FrameSlot {
+    void* start = nullptr;          // mmap'd YUYV data
+    size_t length = 0;
+    int width = 0;                  // geometry negotiated with VIDIOC_S_FMT
+    int height = 0;
+    int stride = 0;                 // bytes per line
+    v4l2_buffer buf{};              // as returned by VIDIOC_DQBUF
+    FrameSignature signature;       // filled by the capture service
+    CoarseMask coarse;              // filled by the capture service
+    uint64_t capture_ns = 0;        // steady clock at VIDIOC_DQBUF
+    uint64_t ready_ns = 0;          // steady clock the source had it ready, 0 if unknown
+    uint64_t published_ns = 0;      // steady clock the capture service handed it on
+    std::atomic<int> refs{0};
+    FrameSource* source = nullptr;  // takes the slot back on last release
+};
+
+// Shared, copyable reference to a dequeued frame slot. Copying bumps the
+// reference count, destruction drops it. No pixel data is ever copied.
+class FrameHandle {
+public:
+    FrameHandle() = default;
+
+    // Adopt a freshly dequeued slot; the slot must have refs == 0
+    explicit FrameHandle(FrameSlot* slot);
+
+    FrameHandle(const FrameHandle& other);
+    FrameHandle(FrameHandle&& other) noexcept;
+    FrameHandle& operator=(const FrameHandle& other);
+    FrameHandle& operator=(FrameHandle&& other) noexcept;
+    ~FrameHandle();
+
+    void reset();
+    bool empty() const { return _slot == nullptr; }
+
+    const uint8_t* data() const { return static_cast<const uint8_t*>(_slot->start); }
+    int width() const { return _slot->width; }
+    int height() const { return _slot->height; }
+    int stride() const { return _slot->stride; }
+    size_t bytesused() const { return _slot->buf.bytesused ? _slot->buf.bytesused : _slot->length; }
+    uint32_t sequence() const { return _slot->buf.sequence; }
+    const timeval& timestamp() const { return _slot->buf.timestamp; }
+    const FrameSignature& signature() const { return _slot->signature; }
+    const CoarseMask& coarse() const { return _slot->coarse; }
+    uint64_t capture_ns() const { return _slot->capture_ns; }
+    uint64_t ready_ns() const { return _slot->ready_ns; }
+    uint64_t published_ns() const { return _slot->published_ns; }
+    // only while the capture service holds the single reference
+    FrameSignature& signature() { return _slot->signature; }
+    CoarseMask& coarse() { return _slot->coarse; }
+    void stamp_capture(uint64_t ns) { _slot->capture_ns = ns; }
+    void stamp_published(uint64_t ns) { _slot->published_ns = ns; }
+
+private:
+    FrameSlot* _slot = nullptr;
+};
+
+// Bytes materialised per frame between VIDIOC_DQBUF and the detector.
+// The legacy hand-off converted into a fresh BGR Mat, cloned it into
+// latest_frame and cloned it again in the detector: three BGR frames.
+struct FrameCopyStats {
+    std::atomic<uint64_t> frames_captured{0};
+    std::atomic<uint64_t> frames_detected{0};
+    std::atomic<uint64_t> bytes_copied{0};
+    std::atomic<uint64_t> bytes_copied_legacy{0};   // what the old path would have copied
+};
+
+extern FrameCopyStats frame_copy_stats;
+
+// Log per-frame copy volume, current path vs. the legacy three-copy path
+void log_frame_copy_stats();
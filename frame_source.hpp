@@ -0,0 +1,95 @@
+/***************************************************************
+ * File: frame_source.hpp
+ * Description: Abstract producer of YUYV frames for the capture
+ *              service. The V4L2 device is one backend, a replayed
+ *              recording is another, so the pipeline can be run and
+ *              profiled without the robot.
+ ***************************************************************/
+
+#pragma once
+
+#include <algorithm>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <thread>
+#include "frame_ring.hpp"
+
+// How often a source whose buffers are all held checks for a release
+#define SOURCE_RELEASE_POLL_US 500
+
+// Sources one process captures from at once, each with its own capture and
+// detect stages (laser_pipeline.hpp)
+#define MAX_CAMERAS 4
+
+// Geometry of the frames a source produces, known once it is open
+struct FrameFormat {
+    uint32_t pixelformat = 0;
+    int width = 0;
+    int height = 0;
+    int stride = 0;             // bytes per line
+    size_t frame_bytes = 0;     // size of one complete frame
+    uint64_t frame_interval_ns = 0; // time between frames, 0 if unknown
+};
+
+class FrameSource {
+public:
+    virtual ~FrameSource() = default;
+
+    // Prepare the source for streaming, returns EXIT_SUCCESS or EXIT_FAILURE
+    virtual int open() = 0;
+
+    // Non-blocking: hand out the next ready frame, false if none is ready
+    virtual bool grab(FrameHandle& frame) = 0;
+
+    // Block until grab() has a frame or `timeout_ms` passed, true if one is
+    // ready; 0 only checks. A source that cannot wait always says ready.
+    virtual bool wait(int /*timeout_ms*/) { return true; }
+
+    // Take back a slot once its last FrameHandle has been dropped
+    virtual void release(FrameSlot& slot) = 0;
+
+    virtual const char* name() const = 0;
+
+    virtual FrameFormat format() const = 0;
+
+    // Frames that can be waiting behind the one grab() hands out, which
+    // bounds a drain; 0 for a source that makes them on demand
+    virtual int buffers() const { return 0; }
+
+    // True once a finite source has served its last frame
+    virtual bool finished() const { return false; }
+
+    // True while consumers hold every buffer: grab() cannot hand out a
+    // frame until one is released, whatever is due
+    virtual bool starved() const { return false; }
+
+    // What went wrong in the last wait() or grab() that waiting does not
+    // cure (the device reported an error or went away), nullptr if nothing
+    virtual const char* error() const { return nullptr; }
+
+protected:
+    // For wait(): sleep until starved() clears or `timeout_ms` passed.
+    // Returns what is left of the timeout, -1 if it ran out.
+    int waitForRelease(int timeout_ms) const
+    {
+        auto until = std::chrono::steady_clock::now() + std::chrono::milliseconds(timeout_ms);
+        while (starved()) {
+            auto now = std::chrono::steady_clock::now();
+            if (now >= until) return -1;
+            std::this_thread::sleep_for(std::min<std::chrono::steady_clock::duration>(
+                until - now, std::chrono::microseconds(SOURCE_RELEASE_POLL_US)));
+        }
+        return int(std::chrono::duration_cast<std::chrono::milliseconds>(
+            until - std::chrono::steady_clock::now()).count());
+    }
+};
+
+// Whether all `count` slots are held by consumers
+inline bool all_slots_held(const FrameSlot* slots, int count)
+{
+    for (int i = 0; i < count; ++i) {
+        if (slots[i].refs.load(std::memory_order_acquire) == 0) return false;
+    }
+    return count > 0;
+}
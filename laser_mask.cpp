@@ -0,0 +1,238 @@
+/***************************************************************
+ * File: laser_mask.cpp
+ * Description: BGR (OpenCV) and direct YUYV laser mask builders.
+ ***************************************************************/
+
+#include "laser_mask.hpp"
+
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+#include <syslog.h>
+#include <vector>
+
+// ITU-R BT.601 fixed point coefficients, as used by OpenCV's YUV422 decoder
+#define YUV_SHIFT 20
+#define YUV_CY    1220542
+#define YUV_CUB   2116026
+#define YUV_CUG   (-409993)
+#define YUV_CVG   (-852492)
+#define YUV_CVR   1673527
+
+// OpenCV's COLOR_BGR2HSV rounds through 12 bit reciprocal tables
+#define HSV_SHIFT 12
+
+static int sdiv_table[256];
+static int hdiv_table[256];
+
+static bool init_tables()
+{
+    sdiv_table[0] = hdiv_table[0] = 0;
+    for (int i = 1; i < 256; i++) {
+        sdiv_table[i] = cvRound((255 << HSV_SHIFT) / (1. * i));
+        hdiv_table[i] = cvRound((180 << HSV_SHIFT) / (6. * i));
+    }
+    return true;
+}
+static const bool tables_ready = init_tables();
+
+
+// thresholdImage() kept min < x <= max; cv::threshold saturates the
+// bounds to the 8 bit range, so a negative min let everything through
+static void legacy_channel(int minimum, int maximum, int& lo, int& hi)
+{
+    if (minimum < 0) {
+        lo = 0;
+        hi = 255;
+    } else {
+        lo = minimum + 1;
+        hi = std::min(maximum, 255);
+    }
+}
+
+ColourClass legacy_colour_class(const char* name, int hue_min, int hue_max, int sat_min,
+                                int sat_max, int val_min, int val_max, int behaviour)
+{
+    ColourClass cls{};
+    snprintf(cls.name, sizeof(cls.name), "%s", name);
+    cls.behaviour = behaviour;
+
+    int h_lo, h_hi, s_lo, s_hi, v_lo, v_hi;
+    legacy_channel(hue_min, hue_max, h_lo, h_hi);
+    legacy_channel(sat_min, sat_max, s_lo, s_hi);
+    legacy_channel(val_min, val_max, v_lo, v_hi);
+
+    // the hue plane was inverted: keep what lies outside [h_lo, h_hi]
+    auto add = [&](int lo, int hi) {
+        cls.ranges[cls.range_count++] = HSVRange{{lo, s_lo, v_lo}, {hi, s_hi, v_hi}};
+    };
+    if (h_lo > h_hi) {
+        add(0, 255);
+    } else {
+        if (h_lo > 0) add(0, h_lo - 1);
+        if (h_hi < 255) add(h_hi + 1, 255);
+    }
+    return cls;
+}
+
+HSVConfig::HSVConfig() : classes{}, class_count(1)
+{
+    classes[0] = legacy_colour_class("laser", 20, 160, 100, 255, 200, 255, 1);
+}
+
+MaskThresholds compile_thresholds(const HSVConfig& cfg)
+{
+    MaskThresholds t{};
+    t.v_lo = t.s_lo = 256;
+    t.v_hi = t.s_hi = -1;
+    for (int c = 0; c < cfg.class_count && c < MAX_COLOUR_CLASSES; ++c) {
+        const ColourClass& cls = cfg.classes[c];
+        for (int r = 0; r < cls.range_count && r < MAX_CLASS_RANGES; ++r) {
+            const HSVRange& in = cls.ranges[r];
+            MaskRange out;
+            out.h_lo = std::max(in.lower[0], 0);
+            out.h_hi = std::min(in.upper[0], 255);
+            out.s_lo = std::max(in.lower[1], 0);
+            out.s_hi = std::min(in.upper[1], 255);
+            out.v_lo = std::max(in.lower[2], 0);
+            out.v_hi = std::min(in.upper[2], 255);
+            out.bits = 1 << c;
+            if (out.h_lo > out.h_hi || out.s_lo > out.s_hi || out.v_lo > out.v_hi) continue;
+
+            t.ranges[t.count++] = out;
+            t.v_lo = std::min(t.v_lo, out.v_lo);
+            t.v_hi = std::max(t.v_hi, out.v_hi);
+            t.s_lo = std::min(t.s_lo, out.s_lo);
+            t.s_hi = std::max(t.s_hi, out.s_hi);
+        }
+    }
+    return t;
+}
+
+void mask_from_bgr(const cv::Mat& bgr, const HSVConfig& cfg, cv::Mat& mask)
+{
+    // Convert to HSV
+    cv::Mat hsv;
+    cv::cvtColor(bgr, hsv, cv::COLOR_BGR2HSV);
+
+    // every range of a class sets the class bit where the pixel is inside it
+    mask.create(bgr.rows, bgr.cols, CV_8UC1);
+    mask.setTo(cv::Scalar(0));
+    cv::Mat in_range;
+    MaskThresholds t = compile_thresholds(cfg);
+    for (int i = 0; i < t.count; ++i) {
+        const MaskRange& r = t.ranges[i];
+        cv::inRange(hsv, cv::Scalar(r.h_lo, r.s_lo, r.v_lo), cv::Scalar(r.h_hi, r.s_hi, r.v_hi), in_range);
+        cv::bitwise_or(mask, cv::Scalar(r.bits), mask, in_range);
+    }
+}
+
+static inline uint8_t clamp_u8(int x)
+{
+    return static_cast<uint8_t>(x < 0 ? 0 : (x > 255 ? 255 : x));
+}
+
+// One pixel: BT.601 YUV -> RGB -> OpenCV HSV -> class bits
+static inline uint8_t classify(int y, int ruv, int guv, int buv, const MaskThresholds& t)
+{
+    int y00 = std::max(0, y - 16) * YUV_CY;
+    int r = clamp_u8((y00 + ruv) >> YUV_SHIFT);
+    int g = clamp_u8((y00 + guv) >> YUV_SHIFT);
+    int b = clamp_u8((y00 + buv) >> YUV_SHIFT);
+
+    int v = std::max(std::max(r, g), b);
+    if (v < t.v_lo || v > t.v_hi) return 0;
+
+    int vmin = std::min(std::min(r, g), b);
+    int diff = v - vmin;
+    int s = (diff * sdiv_table[v] + (1 << (HSV_SHIFT - 1))) >> HSV_SHIFT;
+    if (s < t.s_lo || s > t.s_hi) return 0;
+
+    int h;
+    if (v == r)      h = g - b;
+    else if (v == g) h = b - r + 2 * diff;
+    else             h = r - g + 4 * diff;
+    h = (h * hdiv_table[diff] + (1 << (HSV_SHIFT - 1))) >> HSV_SHIFT;
+    if (h < 0) h += 180;
+
+    int bits = 0;
+    for (int i = 0; i < t.count; ++i) {
+        const MaskRange& m = t.ranges[i];
+        if (h >= m.h_lo && h <= m.h_hi && s >= m.s_lo && s <= m.s_hi && v >= m.v_lo && v <= m.v_hi) {
+            bits |= m.bits;
+        }
+    }
+    return uint8_t(bits);
+}
+
+void mask_row_yuyv(const uint8_t* yuyv, int width, uint8_t* mask, const MaskThresholds& t)
+{
+    // Y0 U Y1 V: two pixels share one chroma pair
+    for (int x = 0; x < width; x += 2, yuyv += 4) {
+        int u = yuyv[1] - 128;
+        int v = yuyv[3] - 128;
+        int ruv = (1 << (YUV_SHIFT - 1)) + YUV_CVR * v;
+        int guv = (1 << (YUV_SHIFT - 1)) + YUV_CVG * v + YUV_CUG * u;
+        int buv = (1 << (YUV_SHIFT - 1)) + YUV_CUB * u;
+        mask[x] = classify(yuyv[0], ruv, guv, buv, t);
+        mask[x + 1] = classify(yuyv[2], ruv, guv, buv, t);
+    }
+}
+
+static const char* kernel_names[KERNEL_COUNT] = {"scalar", "sse4.1", "avx2", "neon"};
+
+const char* mask_kernel_name(MaskKernelIsa isa)
+{
+    return isa < KERNEL_COUNT ? kernel_names[isa] : "unknown";
+}
+
+MaskKernelIsa mask_kernel_from_name(const char* name)
+{
+    for (int i = 0; i < KERNEL_COUNT; ++i) {
+        if (strcmp(name, kernel_names[i]) == 0) return static_cast<MaskKernelIsa>(i);
+    }
+    return KERNEL_COUNT;
+}
+
+static MaskKernelIsa widest_kernel()
+{
+    for (int i = KERNEL_COUNT - 1; i > KERNEL_SCALAR; --i) {
+        if (mask_kernel(static_cast<MaskKernelIsa>(i))) return static_cast<MaskKernelIsa>(i);
+    }
+    return KERNEL_SCALAR;
+}
+
+static MaskKernelIsa active_isa = widest_kernel();
+static MaskRowKernel active_kernel = mask_kernel(active_isa);
+
+bool select_mask_kernel(MaskKernelIsa isa)
+{
+    MaskRowKernel kernel = mask_kernel(isa);
+    if (!kernel) {
+        syslog(LOG_ERR, "mask kernel %s not available on this CPU", mask_kernel_name(isa));
+        return false;
+    }
+    active_isa = isa;
+    active_kernel = kernel;
+    return true;
+}
+
+MaskKernelIsa selected_mask_kernel()
+{
+    return active_isa;
+}
+
+void mask_from_yuyv(const uint8_t* yuyv, int width, int height, int stride,
+                    const HSVConfig& cfg, cv::Mat& mask)
+{
+    mask_from_yuyv(yuyv, width, height, stride, compile_thresholds(cfg), mask);
+}
+
+void mask_from_yuyv(const uint8_t* yuyv, int width, int height, int stride,
+                    const MaskThresholds& t, cv::Mat& mask)
+{
+    mask.create(height, width, CV_8UC1);
+    for (int y = 0; y < height; ++y) {
+        active_kernel(yuyv + size_t(y) * stride, width, mask.ptr<uint8_t>(y), t);
+    }
+}
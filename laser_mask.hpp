@@ -0,0 +1,82 @@
+/***************************************************************
+ * File: laser_mask.hpp
+ * Description: Builders for the class mask. Each mask byte holds one
+ *              bit per colour class of HSVConfig (bit i = classes[i]),
+ *              so every class is classified in the same pass.
+ *
+ *   BGR path : OpenCV chain, YUYV->BGR->HSV, cv::inRange per range,
+ *              OR'd into the class bits.
+ *   YUYV path: classifies every pixel straight from the packed YUYV
+ *              buffer with integer arithmetic, no intermediate images.
+ *              One fused pass writes the final mask; scalar reference
+ *              here, SSE4.1/AVX2/NEON versions in laser_mask_simd.cpp,
+ *              picked at run time.
+ *
+ *              The YUYV path reproduces OpenCV 4.x bit for bit: the
+ *              BT.601 fixed-point YUV422->RGB conversion (20 bit
+ *              coefficients) and the 12 bit division tables of
+ *              COLOR_BGR2HSV are recomputed per pixel. An OpenCV build
+ *              whose YUV422 kernel rounds differently can move R, G or B
+ *              by 1 LSB, which only flips pixels sitting within one step
+ *              of a threshold; detect_bench reports the mismatch count.
+ ***************************************************************/
+
+#pragma once
+
+#include <cstdint>
+#include <opencv2/opencv.hpp>
+#include "red_laser_service.hpp"
+
+#define MAX_MASK_RANGES (MAX_COLOUR_CLASSES * MAX_CLASS_RANGES)
+
+// One range of one class, clamped to 0..255, inclusive
+struct MaskRange {
+    int h_lo, h_hi;
+    int s_lo, s_hi;
+    int v_lo, v_hi;
+    int bits;                   // class bit the range sets
+};
+
+// HSVConfig flattened for the kernels. The V and S envelopes over all
+// ranges let a kernel skip the hue math when no range can match.
+struct MaskThresholds {
+    MaskRange ranges[MAX_MASK_RANGES];
+    int count;
+    int v_lo, v_hi;
+    int s_lo, s_hi;
+};
+
+MaskThresholds compile_thresholds(const HSVConfig& cfg);
+
+// OpenCV chain on a BGR frame, kept as the reference/fallback path
+void mask_from_bgr(const cv::Mat& bgr, const HSVConfig& cfg, cv::Mat& mask);
+
+// One mask row (class bits per pixel) from a packed YUYV row, width must
+// be even. Scalar reference for the vector kernels.
+void mask_row_yuyv(const uint8_t* yuyv, int width, uint8_t* mask, const MaskThresholds& t);
+
+typedef void (*MaskRowKernel)(const uint8_t* yuyv, int width, uint8_t* mask, const MaskThresholds& t);
+
+enum MaskKernelIsa {
+    KERNEL_SCALAR,
+    KERNEL_SSE41,
+    KERNEL_AVX2,
+    KERNEL_NEON,
+    KERNEL_COUNT
+};
+
+// Row kernel for an ISA, nullptr if not built in or not supported by this CPU
+MaskRowKernel mask_kernel(MaskKernelIsa isa);
+const char* mask_kernel_name(MaskKernelIsa isa);
+MaskKernelIsa mask_kernel_from_name(const char* name);   // KERNEL_COUNT if unknown
+
+// Kernel used by mask_from_yuyv(), the widest supported one by default
+bool select_mask_kernel(MaskKernelIsa isa);
+MaskKernelIsa selected_mask_kernel();
+
+// Whole frame from packed YUYV, mask is (re)allocated as CV_8UC1
+void mask_from_yuyv(const uint8_t* yuyv, int width, int height, int stride,
+                    const HSVConfig& cfg, cv::Mat& mask);
+// Same with the thresholds already compiled (config snapshots carry them)
+void mask_from_yuyv(const uint8_t* yuyv, int width, int height, int stride,
+                    const MaskThresholds& t, cv::Mat& mask);
@@ -0,0 +1,402 @@
+/***************************************************************
+ * File: laser_mask_simd.cpp
+ * Description: Vector versions of the fused YUYV class mask kernel.
+ *
+ *              Each 32 bit lane holds one YUYV macropixel (Y0 U Y1 V),
+ *              so the even and odd pixels of a pair are classified in
+ *              two passes over the same chroma terms. Everything stays
+ *              in 32 bit integers, as in the scalar kernel, so the
+ *              result is bit-exact with it. The two reciprocal tables
+ *              of OpenCV's BGR2HSV are rebuilt in-register:
+ *
+ *                sdiv[v]    = round(255*4096 / v)    = (2*1044480 + v) / 2v
+ *                hdiv[diff] = round(180*4096 / 6diff) = (2*122880 + diff) / 2diff
+ *
+ *              (no ties exist for 8 bit operands). The integer division
+ *              is a float estimate corrected by one step each way.
+ *
+ *              x86 kernels use function target attributes, so the file
+ *              builds without -m flags and the ISA is chosen at run time.
+ *              On 32-bit ARM the Makefile builds this file alone with
+ *              -mfpu=neon, and AT_HWCAP decides whether the kernel runs.
+ ***************************************************************/
+
+#include "laser_mask.hpp"
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#define HAVE_X86_KERNELS 1
+#endif
+
+#if defined(__ARM_NEON) || defined(__ARM_NEON__)
+#include <arm_neon.h>
+#define HAVE_NEON_KERNEL 1
+#if !defined(__aarch64__)
+#include <sys/auxv.h>
+#include <asm/hwcap.h>
+#endif
+#endif
+
+#define YUV_SHIFT 20
+#define YUV_CY    1220542
+#define YUV_CUB   2116026
+#define YUV_CUG   (-409993)
+#define YUV_CVG   (-852492)
+#define YUV_CVR   1673527
+#define HSV_SHIFT 12
+#define SDIV_NUM  (2 * (255 << HSV_SHIFT))
+#define HDIV_NUM  (2 * ((180 << HSV_SHIFT) / 6))
+
+#ifdef HAVE_X86_KERNELS
+
+/* ---------------------------------------------------------- SSE4.1 */
+
+#define SSE41 __attribute__((target("sse4.1")))
+
+// floor(n / d) for 0 < d, 0 <= n < 2^22
+SSE41 static inline __m128i div_sse41(__m128i n, __m128i d)
+{
+    __m128i q = _mm_cvttps_epi32(_mm_div_ps(_mm_cvtepi32_ps(n), _mm_cvtepi32_ps(d)));
+    __m128i qd = _mm_mullo_epi32(q, d);
+    __m128i over = _mm_cmpgt_epi32(qd, n);                          // q*d > n
+    q = _mm_add_epi32(q, over);
+    qd = _mm_add_epi32(qd, _mm_and_si128(over, _mm_sub_epi32(_mm_setzero_si128(), d)));
+    __m128i under = _mm_cmpgt_epi32(_mm_add_epi32(qd, d), n);       // (q+1)*d > n
+    return _mm_sub_epi32(q, _mm_andnot_si128(under, _mm_set1_epi32(-1)));
+}
+
+SSE41 static inline __m128i in_range_sse41(__m128i x, __m128i lo, __m128i hi)
+{
+    return _mm_andnot_si128(_mm_or_si128(_mm_cmplt_epi32(x, lo), _mm_cmpgt_epi32(x, hi)),
+                            _mm_set1_epi32(-1));
+}
+
+// class bits per lane for one pixel of each macropixel
+SSE41 static inline __m128i classify_sse41(__m128i y, __m128i ruv, __m128i guv, __m128i buv,
+                                           const MaskThresholds& t)
+{
+    const __m128i zero = _mm_setzero_si128();
+    const __m128i one = _mm_set1_epi32(1);
+    const __m128i c255 = _mm_set1_epi32(255);
+    const __m128i half = _mm_set1_epi32(1 << (HSV_SHIFT - 1));
+
+    __m128i y00 = _mm_mullo_epi32(_mm_max_epi32(_mm_sub_epi32(y, _mm_set1_epi32(16)), zero),
+                                  _mm_set1_epi32(YUV_CY));
+    __m128i r = _mm_min_epi32(_mm_max_epi32(_mm_srai_epi32(_mm_add_epi32(y00, ruv), YUV_SHIFT), zero), c255);
+    __m128i g = _mm_min_epi32(_mm_max_epi32(_mm_srai_epi32(_mm_add_epi32(y00, guv), YUV_SHIFT), zero), c255);
+    __m128i b = _mm_min_epi32(_mm_max_epi32(_mm_srai_epi32(_mm_add_epi32(y00, buv), YUV_SHIFT), zero), c255);
+
+    __m128i v = _mm_max_epi32(_mm_max_epi32(r, g), b);
+    __m128i pass = in_range_sse41(v, _mm_set1_epi32(t.v_lo), _mm_set1_epi32(t.v_hi));
+    if (_mm_testz_si128(pass, pass)) return pass;
+
+    __m128i diff = _mm_sub_epi32(v, _mm_min_epi32(_mm_min_epi32(r, g), b));
+
+    // saturation, sdiv[0] = 0
+    __m128i v1 = _mm_max_epi32(v, one);
+    __m128i sdiv = _mm_and_si128(div_sse41(_mm_add_epi32(_mm_set1_epi32(SDIV_NUM), v),
+                                           _mm_add_epi32(v1, v1)), _mm_cmpgt_epi32(v, zero));
+    __m128i s = _mm_srai_epi32(_mm_add_epi32(_mm_mullo_epi32(diff, sdiv), half), HSV_SHIFT);
+    pass = _mm_and_si128(pass, in_range_sse41(s, _mm_set1_epi32(t.s_lo), _mm_set1_epi32(t.s_hi)));
+    if (_mm_testz_si128(pass, pass)) return pass;
+
+    // hue, hdiv[0] = 0
+    __m128i d1 = _mm_max_epi32(diff, one);
+    __m128i hdiv = _mm_and_si128(div_sse41(_mm_add_epi32(_mm_set1_epi32(HDIV_NUM), diff),
+                                           _mm_add_epi32(d1, d1)), _mm_cmpgt_epi32(diff, zero));
+    __m128i diff2 = _mm_add_epi32(diff, diff);
+    __m128i h_r = _mm_sub_epi32(g, b);
+    __m128i h_g = _mm_add_epi32(_mm_sub_epi32(b, r), diff2);
+    __m128i h_b = _mm_add_epi32(_mm_sub_epi32(r, g), _mm_add_epi32(diff2, diff2));
+    __m128i h = _mm_blendv_epi8(h_b, h_g, _mm_cmpeq_epi32(v, g));
+    h = _mm_blendv_epi8(h, h_r, _mm_cmpeq_epi32(v, r));
+    h = _mm_srai_epi32(_mm_add_epi32(_mm_mullo_epi32(h, hdiv), half), HSV_SHIFT);
+    h = _mm_add_epi32(h, _mm_and_si128(_mm_cmplt_epi32(h, zero), _mm_set1_epi32(180)));
+
+    __m128i bits = zero;
+    for (int i = 0; i < t.count; ++i) {
+        const MaskRange& m = t.ranges[i];
+        __m128i in = _mm_and_si128(in_range_sse41(h, _mm_set1_epi32(m.h_lo), _mm_set1_epi32(m.h_hi)),
+                                   in_range_sse41(s, _mm_set1_epi32(m.s_lo), _mm_set1_epi32(m.s_hi)));
+        in = _mm_and_si128(in, in_range_sse41(v, _mm_set1_epi32(m.v_lo), _mm_set1_epi32(m.v_hi)));
+        bits = _mm_or_si128(bits, _mm_and_si128(in, _mm_set1_epi32(m.bits)));
+    }
+    return _mm_and_si128(pass, bits);
+}
+
+SSE41 static void mask_row_yuyv_sse41(const uint8_t* yuyv, int width, uint8_t* mask,
+                                      const MaskThresholds& t)
+{
+    const __m128i lo8 = _mm_set1_epi32(0xff);
+    const __m128i round = _mm_set1_epi32(1 << (YUV_SHIFT - 1));
+    int x = 0;
+    for (; x + 8 <= width; x += 8, yuyv += 16) {
+        __m128i raw = _mm_loadu_si128(reinterpret_cast<const __m128i*>(yuyv));
+        __m128i y_even = _mm_and_si128(raw, lo8);
+        __m128i u = _mm_sub_epi32(_mm_and_si128(_mm_srli_epi32(raw, 8), lo8), _mm_set1_epi32(128));
+        __m128i y_odd = _mm_and_si128(_mm_srli_epi32(raw, 16), lo8);
+        __m128i v = _mm_sub_epi32(_mm_srli_epi32(raw, 24), _mm_set1_epi32(128));
+
+        __m128i ruv = _mm_add_epi32(round, _mm_mullo_epi32(v, _mm_set1_epi32(YUV_CVR)));
+        __m128i guv = _mm_add_epi32(round, _mm_add_epi32(_mm_mullo_epi32(v, _mm_set1_epi32(YUV_CVG)),
+                                                         _mm_mullo_epi32(u, _mm_set1_epi32(YUV_CUG))));
+        __m128i buv = _mm_add_epi32(round, _mm_mullo_epi32(u, _mm_set1_epi32(YUV_CUB)));
+
+        __m128i m_even = classify_sse41(y_even, ruv, guv, buv, t);
+        __m128i m_odd = classify_sse41(y_odd, ruv, guv, buv, t);
+
+        // lane k -> bytes [even k, odd k], then 32->16 bit narrowing
+        __m128i pairs = _mm_or_si128(m_even, _mm_slli_epi32(m_odd, 8));
+        _mm_storel_epi64(reinterpret_cast<__m128i*>(mask + x), _mm_packus_epi32(pairs, pairs));
+    }
+    if (x < width) mask_row_yuyv(yuyv, width - x, mask + x, t);
+}
+
+/* ------------------------------------------------------------ AVX2 */
+
+#define AVX2 __attribute__((target("avx2")))
+
+AVX2 static inline __m256i div_avx2(__m256i n, __m256i d)
+{
+    __m256i q = _mm256_cvttps_epi32(_mm256_div_ps(_mm256_cvtepi32_ps(n), _mm256_cvtepi32_ps(d)));
+    __m256i qd = _mm256_mullo_epi32(q, d);
+    __m256i over = _mm256_cmpgt_epi32(qd, n);
+    q = _mm256_add_epi32(q, over);
+    qd = _mm256_add_epi32(qd, _mm256_and_si256(over, _mm256_sub_epi32(_mm256_setzero_si256(), d)));
+    __m256i under = _mm256_cmpgt_epi32(_mm256_add_epi32(qd, d), n);
+    return _mm256_sub_epi32(q, _mm256_andnot_si256(under, _mm256_set1_epi32(-1)));
+}
+
+AVX2 static inline __m256i in_range_avx2(__m256i x, __m256i lo, __m256i hi)
+{
+    return _mm256_andnot_si256(_mm256_or_si256(_mm256_cmpgt_epi32(lo, x), _mm256_cmpgt_epi32(x, hi)),
+                               _mm256_set1_epi32(-1));
+}
+
+AVX2 static inline __m256i classify_avx2(__m256i y, __m256i ruv, __m256i guv, __m256i buv,
+                                         const MaskThresholds& t)
+{
+    const __m256i zero = _mm256_setzero_si256();
+    const __m256i one = _mm256_set1_epi32(1);
+    const __m256i c255 = _mm256_set1_epi32(255);
+    const __m256i half = _mm256_set1_epi32(1 << (HSV_SHIFT - 1));
+
+    __m256i y00 = _mm256_mullo_epi32(_mm256_max_epi32(_mm256_sub_epi32(y, _mm256_set1_epi32(16)), zero),
+                                     _mm256_set1_epi32(YUV_CY));
+    __m256i r = _mm256_min_epi32(_mm256_max_epi32(_mm256_srai_epi32(_mm256_add_epi32(y00, ruv), YUV_SHIFT), zero), c255);
+    __m256i g = _mm256_min_epi32(_mm256_max_epi32(_mm256_srai_epi32(_mm256_add_epi32(y00, guv), YUV_SHIFT), zero), c255);
+    __m256i b = _mm256_min_epi32(_mm256_max_epi32(_mm256_srai_epi32(_mm256_add_epi32(y00, buv), YUV_SHIFT), zero), c255);
+
+    __m256i v = _mm256_max_epi32(_mm256_max_epi32(r, g), b);
+    __m256i pass = in_range_avx2(v, _mm256_set1_epi32(t.v_lo), _mm256_set1_epi32(t.v_hi));
+    if (_mm256_testz_si256(pass, pass)) return pass;
+
+    __m256i diff = _mm256_sub_epi32(v, _mm256_min_epi32(_mm256_min_epi32(r, g), b));
+
+    __m256i v1 = _mm256_max_epi32(v, one);
+    __m256i sdiv = _mm256_and_si256(div_avx2(_mm256_add_epi32(_mm256_set1_epi32(SDIV_NUM), v),
+                                             _mm256_add_epi32(v1, v1)), _mm256_cmpgt_epi32(v, zero));
+    __m256i s = _mm256_srai_epi32(_mm256_add_epi32(_mm256_mullo_epi32(diff, sdiv), half), HSV_SHIFT);
+    pass = _mm256_and_si256(pass, in_range_avx2(s, _mm256_set1_epi32(t.s_lo), _mm256_set1_epi32(t.s_hi)));
+    if (_mm256_testz_si256(pass, pass)) return pass;
+
+    __m256i d1 = _mm256_max_epi32(diff, one);
+    __m256i hdiv = _mm256_and_si256(div_avx2(_mm256_add_epi32(_mm256_set1_epi32(HDIV_NUM), diff),
+                                             _mm256_add_epi32(d1, d1)), _mm256_cmpgt_epi32(diff, zero));
+    __m256i diff2 = _mm256_add_epi32(diff, diff);
+    __m256i h_r = _mm256_sub_epi32(g, b);
+    __m256i h_g = _mm256_add_epi32(_mm256_sub_epi32(b, r), diff2);
+    __m256i h_b = _mm256_add_epi32(_mm256_sub_epi32(r, g), _mm256_add_epi32(diff2, diff2));
+    __m256i h = _mm256_blendv_epi8(h_b, h_g, _mm256_cmpeq_epi32(v, g));
+    h = _mm256_blendv_epi8(h, h_r, _mm256_cmpeq_epi32(v, r));
+    h = _mm256_srai_epi32(_mm256_add_epi32(_mm256_mullo_epi32(h, hdiv), half), HSV_SHIFT);
+    h = _mm256_add_epi32(h, _mm256_and_si256(_mm256_cmpgt_epi32(zero, h), _mm256_set1_epi32(180)));
+
+    __m256i bits = zero;
+    for (int i = 0; i < t.count; ++i) {
+        const MaskRange& m = t.ranges[i];
+        __m256i in = _mm256_and_si256(in_range_avx2(h, _mm256_set1_epi32(m.h_lo), _mm256_set1_epi32(m.h_hi)),
+                                      in_range_avx2(s, _mm256_set1_epi32(m.s_lo), _mm256_set1_epi32(m.s_hi)));
+        in = _mm256_and_si256(in, in_range_avx2(v, _mm256_set1_epi32(m.v_lo), _mm256_set1_epi32(m.v_hi)));
+        bits = _mm256_or_si256(bits, _mm256_and_si256(in, _mm256_set1_epi32(m.bits)));
+    }
+    return _mm256_and_si256(pass, bits);
+}
+
+AVX2 static void mask_row_yuyv_avx2(const uint8_t* yuyv, int width, uint8_t* mask,
+                                    const MaskThresholds& t)
+{
+    const __m256i lo8 = _mm256_set1_epi32(0xff);
+    const __m256i round = _mm256_set1_epi32(1 << (YUV_SHIFT - 1));
+    int x = 0;
+    for (; x + 16 <= width; x += 16, yuyv += 32) {
+        __m256i raw = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(yuyv));
+        __m256i y_even = _mm256_and_si256(raw, lo8);
+        __m256i u = _mm256_sub_epi32(_mm256_and_si256(_mm256_srli_epi32(raw, 8), lo8), _mm256_set1_epi32(128));
+        __m256i y_odd = _mm256_and_si256(_mm256_srli_epi32(raw, 16), lo8);
+        __m256i v = _mm256_sub_epi32(_mm256_srli_epi32(raw, 24), _mm256_set1_epi32(128));
+
+        __m256i ruv = _mm256_add_epi32(round, _mm256_mullo_epi32(v, _mm256_set1_epi32(YUV_CVR)));
+        __m256i guv = _mm256_add_epi32(round, _mm256_add_epi32(_mm256_mullo_epi32(v, _mm256_set1_epi32(YUV_CVG)),
+                                                               _mm256_mullo_epi32(u, _mm256_set1_epi32(YUV_CUG))));
+        __m256i buv = _mm256_add_epi32(round, _mm256_mullo_epi32(u, _mm256_set1_epi32(YUV_CUB)));
+
+        __m256i m_even = classify_avx2(y_even, ruv, guv, buv, t);
+        __m256i m_odd = classify_avx2(y_odd, ruv, guv, buv, t);
+
+        __m256i pairs = _mm256_or_si256(m_even, _mm256_slli_epi32(m_odd, 8));
+        // packus works per 128 bit half, gather the two low quadwords
+        __m256i packed = _mm256_permute4x64_epi64(_mm256_packus_epi32(pairs, pairs), 0x08);
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(mask + x), _mm256_castsi256_si128(packed));
+    }
+    if (x < width) mask_row_yuyv(yuyv, width - x, mask + x, t);
+}
+
+#endif // HAVE_X86_KERNELS
+
+#ifdef HAVE_NEON_KERNEL
+
+/* ------------------------------------------------------------ NEON */
+
+static inline int32x4_t div_neon(int32x4_t n, int32x4_t d)
+{
+    float32x4_t fn = vcvtq_f32_s32(n);
+    float32x4_t fd = vcvtq_f32_s32(d);
+#if defined(__aarch64__)
+    float32x4_t fq = vdivq_f32(fn, fd);
+#else
+    // ARMv7 has no vector divide: reciprocal estimate plus two Newton steps
+    float32x4_t rcp = vrecpeq_f32(fd);
+    rcp = vmulq_f32(vrecpsq_f32(fd, rcp), rcp);
+    rcp = vmulq_f32(vrecpsq_f32(fd, rcp), rcp);
+    float32x4_t fq = vmulq_f32(fn, rcp);
+#endif
+    int32x4_t q = vcvtq_s32_f32(fq);
+    int32x4_t qd = vmulq_s32(q, d);
+    uint32x4_t over = vcgtq_s32(qd, n);
+    q = vaddq_s32(q, vreinterpretq_s32_u32(over));
+    qd = vsubq_s32(qd, vandq_s32(vreinterpretq_s32_u32(over), d));
+    uint32x4_t next_ok = vcleq_s32(vaddq_s32(qd, d), n);           // (q+1)*d <= n
+    return vsubq_s32(q, vreinterpretq_s32_u32(next_ok));
+}
+
+static inline uint32x4_t in_range_neon(int32x4_t x, int lo, int hi)
+{
+    return vandq_u32(vcgeq_s32(x, vdupq_n_s32(lo)), vcleq_s32(x, vdupq_n_s32(hi)));
+}
+
+static inline bool any_lane_neon(uint32x4_t m)
+{
+#if defined(__aarch64__)
+    return vmaxvq_u32(m) != 0;
+#else
+    uint32x2_t r = vorr_u32(vget_low_u32(m), vget_high_u32(m));
+    return (vget_lane_u32(r, 0) | vget_lane_u32(r, 1)) != 0;
+#endif
+}
+
+static inline uint32x4_t classify_neon(int32x4_t y, int32x4_t ruv, int32x4_t guv, int32x4_t buv,
+                                       const MaskThresholds& t)
+{
+    const int32x4_t zero = vdupq_n_s32(0);
+    const int32x4_t one = vdupq_n_s32(1);
+    const int32x4_t c255 = vdupq_n_s32(255);
+    const int32x4_t half = vdupq_n_s32(1 << (HSV_SHIFT - 1));
+
+    int32x4_t y00 = vmulq_s32(vmaxq_s32(vsubq_s32(y, vdupq_n_s32(16)), zero), vdupq_n_s32(YUV_CY));
+    int32x4_t r = vminq_s32(vmaxq_s32(vshrq_n_s32(vaddq_s32(y00, ruv), YUV_SHIFT), zero), c255);
+    int32x4_t g = vminq_s32(vmaxq_s32(vshrq_n_s32(vaddq_s32(y00, guv), YUV_SHIFT), zero), c255);
+    int32x4_t b = vminq_s32(vmaxq_s32(vshrq_n_s32(vaddq_s32(y00, buv), YUV_SHIFT), zero), c255);
+
+    int32x4_t v = vmaxq_s32(vmaxq_s32(r, g), b);
+    uint32x4_t pass = in_range_neon(v, t.v_lo, t.v_hi);
+    if (!any_lane_neon(pass)) return pass;
+
+    int32x4_t diff = vsubq_s32(v, vminq_s32(vminq_s32(r, g), b));
+
+    int32x4_t v1 = vmaxq_s32(v, one);
+    int32x4_t sdiv = vandq_s32(div_neon(vaddq_s32(vdupq_n_s32(SDIV_NUM), v), vaddq_s32(v1, v1)),
+                               vreinterpretq_s32_u32(vcgtq_s32(v, zero)));
+    int32x4_t s = vshrq_n_s32(vaddq_s32(vmulq_s32(diff, sdiv), half), HSV_SHIFT);
+    pass = vandq_u32(pass, in_range_neon(s, t.s_lo, t.s_hi));
+    if (!any_lane_neon(pass)) return pass;
+
+    int32x4_t d1 = vmaxq_s32(diff, one);
+    int32x4_t hdiv = vandq_s32(div_neon(vaddq_s32(vdupq_n_s32(HDIV_NUM), diff), vaddq_s32(d1, d1)),
+                               vreinterpretq_s32_u32(vcgtq_s32(diff, zero)));
+    int32x4_t diff2 = vaddq_s32(diff, diff);
+    int32x4_t h_r = vsubq_s32(g, b);
+    int32x4_t h_g = vaddq_s32(vsubq_s32(b, r), diff2);
+    int32x4_t h_b = vaddq_s32(vsubq_s32(r, g), vaddq_s32(diff2, diff2));
+    int32x4_t h = vbslq_s32(vceqq_s32(v, g), h_g, h_b);
+    h = vbslq_s32(vceqq_s32(v, r), h_r, h);
+    h = vshrq_n_s32(vaddq_s32(vmulq_s32(h, hdiv), half), HSV_SHIFT);
+    h = vaddq_s32(h, vandq_s32(vreinterpretq_s32_u32(vcltq_s32(h, zero)), vdupq_n_s32(180)));
+
+    uint32x4_t bits = vdupq_n_u32(0);
+    for (int i = 0; i < t.count; ++i) {
+        const MaskRange& m = t.ranges[i];
+        uint32x4_t in = vandq_u32(in_range_neon(h, m.h_lo, m.h_hi), in_range_neon(s, m.s_lo, m.s_hi));
+        in = vandq_u32(in, in_range_neon(v, m.v_lo, m.v_hi));
+        bits = vorrq_u32(bits, vandq_u32(in, vdupq_n_u32(m.bits)));
+    }
+    return vandq_u32(pass, bits);
+}
+
+static void mask_row_yuyv_neon(const uint8_t* yuyv, int width, uint8_t* mask,
+                               const MaskThresholds& t)
+{
+    const uint32x4_t lo8 = vdupq_n_u32(0xff);
+    const int32x4_t round = vdupq_n_s32(1 << (YUV_SHIFT - 1));
+    const int32x4_t c128 = vdupq_n_s32(128);
+    int x = 0;
+    for (; x + 8 <= width; x += 8, yuyv += 16) {
+        uint32x4_t raw = vreinterpretq_u32_u8(vld1q_u8(yuyv));
+        int32x4_t y_even = vreinterpretq_s32_u32(vandq_u32(raw, lo8));
+        int32x4_t u = vsubq_s32(vreinterpretq_s32_u32(vandq_u32(vshrq_n_u32(raw, 8), lo8)), c128);
+        int32x4_t y_odd = vreinterpretq_s32_u32(vandq_u32(vshrq_n_u32(raw, 16), lo8));
+        int32x4_t v = vsubq_s32(vreinterpretq_s32_u32(vshrq_n_u32(raw, 24)), c128);
+
+        int32x4_t ruv = vmlaq_s32(round, v, vdupq_n_s32(YUV_CVR));
+        int32x4_t guv = vmlaq_s32(vmlaq_s32(round, v, vdupq_n_s32(YUV_CVG)), u, vdupq_n_s32(YUV_CUG));
+        int32x4_t buv = vmlaq_s32(round, u, vdupq_n_s32(YUV_CUB));
+
+        uint32x4_t m_even = classify_neon(y_even, ruv, guv, buv, t);
+        uint32x4_t m_odd = classify_neon(y_odd, ruv, guv, buv, t);
+
+        // lane k -> bytes [even k, odd k], narrow to 16 bit, store 8 bytes
+        uint32x4_t pairs = vorrq_u32(m_even, vshlq_n_u32(m_odd, 8));
+        vst1_u8(mask + x, vreinterpret_u8_u16(vmovn_u32(pairs)));
+    }
+    if (x < width) mask_row_yuyv(yuyv, width - x, mask + x, t);
+}
+
+#endif // HAVE_NEON_KERNEL
+
+/* -------------------------------------------------------- dispatch */
+
+MaskRowKernel mask_kernel(MaskKernelIsa isa)
+{
+    switch (isa) {
+        case KERNEL_SCALAR:
+            return mask_row_yuyv;
+#ifdef HAVE_X86_KERNELS
+        case KERNEL_SSE41:
+            __builtin_cpu_init();   // may run from a static initializer
+            return __builtin_cpu_supports("sse4.1") ? mask_row_yuyv_sse41 : nullptr;
+        case KERNEL_AVX2:
+            __builtin_cpu_init();
+            return __builtin_cpu_supports("avx2") ? mask_row_yuyv_avx2 : nullptr;
+#endif
+#ifdef HAVE_NEON_KERNEL
+        case KERNEL_NEON:
+#if defined(__aarch64__)
+            return mask_row_yuyv_neon;
+#else
+            return (getauxval(AT_HWCAP) & HWCAP_NEON) ? mask_row_yuyv_neon : nullptr;
+#endif
+#endif
+        default:
+            return nullptr;
+    }
+}
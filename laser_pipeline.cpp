@@ -0,0 +1,63 @@
+/***************************************************************
+ * File: laser_pipeline.cpp
+ * Description: Stage wiring of the robot's pipeline.
+ ***************************************************************/
+
+#include "laser_pipeline.hpp"
+#include "motor_control.hpp"
+
+#include <algorithm>
+
+LaserChannels::LaserChannels(int count)
+{
+    for (int i = 0; i < count && i < MAX_CAMERAS; ++i) {
+        cameras.push_back(std::make_unique<CameraPipeline>(i));
+    }
+}
+
+void build_laser_pipeline(Pipeline& graph, LaserChannels& ch, bool motors)
+{
+    //every period follows the frame interval the cameras negotiated; the
+    //stages after detection keep up with the fastest camera
+    StagePeriods shared = ch.cameras.front()->camera.periods();
+    for (auto& cam : ch.cameras) {
+        CameraPipeline& c = *cam;
+        const StagePeriods& periods = c.camera.periods();
+        shared.detect = std::min(shared.detect, periods.detect);
+        shared.decide = std::min(shared.decide, periods.decide);
+        shared.motors = std::min(shared.motors, periods.motors);
+
+        //camera service released a little faster than the frame rate, or
+        //free-running and blocked in poll() until each frame lands
+        int capture_period = capture_wake == CAPTURE_ON_FRAME ? -1 : periods.capture;
+        graph.add(camera_stage_names[c.camera.index()].capture, capture_period,
+                  [&c] { c.camera.capture(c.frames, c.detector.fullScanNext()); })
+            .writes(c.frames)
+            .core(c.core);
+        graph.add(camera_stage_names[c.camera.index()].detect, periods.detect,
+                  [&c] { c.detector.detect(c.frames, c.points, c.class_points); })
+            .reads(c.frames)
+            .writes(c.points)
+            .writes(c.class_points)
+            .core(c.core);
+    }
+
+    //with several cameras the decision follows the best of their points
+    Channel<Point2D>* decide_points = &ch.cameras.front()->points;
+    if (ch.cameras.size() > 1) {
+        std::vector<Channel<Point2D>*> inputs;
+        for (auto& cam : ch.cameras) inputs.push_back(&cam->points);
+        Stage& fusion = graph.add("fusion", shared.detect, [&ch, inputs] { ch.fusion.fuse(inputs, ch.points); });
+        for (Channel<Point2D>* in : inputs) fusion.reads(*in);
+        fusion.writes(ch.points);
+        decide_points = &ch.points;
+    }
+    graph.add("decide", shared.decide, [&ch, decide_points] { service3_thread(*decide_points, ch.track, ch.commands); })
+        .reads(*decide_points)
+        .writes(ch.track)
+        .writes(ch.commands);
+    if (motors) {
+        graph.add("motors", shared.motors, [&ch] { motor_control_service(ch.commands); })
+            .reads(ch.commands);
+    }
+}
@@ -0,0 +1,71 @@
+/***************************************************************
+ * File: laser_pipeline.hpp
+ * Description: The robot's pipeline: capture -> detect on every camera,
+ *              -> fusion -> decide -> motors. Each camera's chain and
+ *              channels are grouped in a CameraPipeline, the shared rest
+ *              in LaserChannels, and build_laser_pipeline() is the only
+ *              place that says which stage reads and writes which.
+ ***************************************************************/
+
+#pragma once
+
+#include <memory>
+#include <vector>
+#include "pipeline.hpp"
+#include "cameraService.hpp"
+#include "red_laser_service.hpp"
+#include "point_fusion.hpp"
+#include "direction_deciding.hpp"
+#include "laser_tracker.hpp"
+
+// Stage and channel names have to outlive the graph; the first camera
+// keeps the names of the single camera pipeline
+inline constexpr struct {
+    const char* capture;
+    const char* detect;
+    const char* frames;
+    const char* points;
+    const char* class_points;
+} camera_stage_names[MAX_CAMERAS] = {
+    {"capture", "detect", "frames", "laser point", "class points"},
+    {"capture 1", "detect 1", "frames 1", "laser point 1", "class points 1"},
+    {"capture 2", "detect 2", "frames 2", "laser point 2", "class points 2"},
+    {"capture 3", "detect 3", "frames 3", "laser point 3", "class points 3"},
+};
+
+// One camera's capture -> detect chain, also run on its own by the bench.
+// The camera comes first: its source must outlive the frame channel,
+// which releases its slot on destruction.
+struct CameraPipeline {
+    explicit CameraPipeline(int index)
+        : camera(index), detector(index), frames(camera_stage_names[index].frames),
+          points(camera_stage_names[index].points), class_points(camera_stage_names[index].class_points) {}
+
+    Camera camera;
+    LaserDetector detector;
+    int core = 1;                       // capture and detect run here
+    FrameChannel frames;                // capture -> detect
+    Channel<Point2D> points;            // detect -> fusion, or decide with one camera
+    Channel<ClassPoints> class_points;  // detect -> (tools)
+};
+
+struct LaserChannels {
+    explicit LaserChannels(int cameras = 1);
+
+    std::vector<std::unique_ptr<CameraPipeline>> cameras;
+    Channel<Point2D> points{"fused point"};             // fusion -> decide
+    Channel<TrackState> track{"track state"};           // decide -> (tools)
+    Channel<MovementCommand> commands{"movement command"};  // decide -> motors
+    PointFusion fusion;
+};
+
+// Stages build_laser_pipeline() declares at most: capture and detect per
+// camera, then fusion, decide and motors. Numbered from service 1, the
+// last stage and the config service after it keep their own lock stats.
+#define LASER_PIPELINE_MAX_STAGES (2 * MAX_CAMERAS + 3)
+static_assert(LASER_PIPELINE_MAX_STAGES + 1 < LOCK_STAT_SERVICES,
+              "lock stats would charge the last services to \"other\"");
+
+// Declare the stages of one instance on `graph`. Without `motors` the
+// command channel has no reader (replay on a dev box).
+void build_laser_pipeline(Pipeline& graph, LaserChannels& channels, bool motors);
@@ -0,0 +1,126 @@
+/***************************************************************
+ * File: laser_tracker.cpp
+ * Description: Alpha-beta tracking of the laser dot and the pipeline
+ *              latency used to predict it to actuation time.
+ ***************************************************************/
+
+#include "laser_tracker.hpp"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <syslog.h>
+
+AlphaBetaTracker laser_tracker;
+
+// written by service 3 and service 4, read by service 3
+static std::atomic<double> decision_latency_ns{0};
+static std::atomic<double> actuation_latency_ns{0};
+static std::atomic<uint64_t> decision_latency_max_ns{0};
+static std::atomic<uint64_t> actuation_latency_max_ns{0};
+
+void AlphaBetaTracker::_restart(const Point2D& point)
+{
+    _state.valid = true;
+    _state.x = _state.px = point.x;
+    _state.y = _state.py = point.y;
+    _state.vx = _state.vy = 0;
+    _state.confidence = TRACK_CONFIDENCE_GAIN;
+    _state.t_ns = _state.predict_ns = point.t_ns;
+    _state.behav = point.behav;
+    _state.camera = point.camera;
+    ++_restarts;
+}
+
+bool AlphaBetaTracker::update(const Point2D& point)
+{
+    bool same_camera = point.camera == _state.camera;
+    if (_state.valid && same_camera && point.t_ns <= _state.t_ns) return false;
+    ++_updates;
+
+    if (!_state.valid || !same_camera || point.t_ns > _state.t_ns + TRACK_COAST_NS) {
+        _restart(point);
+        return true;
+    }
+
+    float dt = (point.t_ns - _state.t_ns) * 1e-9f;
+    float xp = _state.x + _state.vx * dt;
+    float yp = _state.y + _state.vy * dt;
+    float rx = point.x - xp;
+    float ry = point.y - yp;
+    // a jump this far is another dot (or a reflection), not motion
+    if (std::hypot(rx, ry) > TRACK_GATE_PX) {
+        _restart(point);
+        return true;
+    }
+
+    _state.x = xp + TRACK_ALPHA * rx;
+    _state.y = yp + TRACK_ALPHA * ry;
+    _state.vx += TRACK_BETA * rx / dt;
+    _state.vy += TRACK_BETA * ry / dt;
+    _state.confidence += (1.0f - _state.confidence) * TRACK_CONFIDENCE_GAIN;
+    _state.t_ns = point.t_ns;
+    _state.behav = point.behav;
+    return true;
+}
+
+TrackState AlphaBetaTracker::predict(uint64_t t_ns) const
+{
+    TrackState s = _state;
+    if (!s.valid) return s;
+
+    uint64_t age = t_ns > s.t_ns ? t_ns - s.t_ns : 0;
+    if (age > TRACK_COAST_NS) {
+        s.valid = false;
+        s.confidence = 0;
+        return s;
+    }
+    float dt = age * 1e-9f;
+    s.px = s.x + s.vx * dt;
+    s.py = s.y + s.vy * dt;
+    s.predict_ns = t_ns;
+    s.confidence *= 1.0f - float(age) / TRACK_COAST_NS;
+    return s;
+}
+
+static void ewma(std::atomic<double>& average, uint64_t ns)
+{
+    double old = average.load(std::memory_order_relaxed);
+    average.store(old == 0 ? double(ns) : old + LATENCY_EWMA * (double(ns) - old),
+                  std::memory_order_relaxed);
+}
+
+static void note_max(std::atomic<uint64_t>& max, uint64_t ns)
+{
+    if (ns > max.load(std::memory_order_relaxed)) max.store(ns, std::memory_order_relaxed);
+}
+
+void note_decision_latency(uint64_t ns)
+{
+    ewma(decision_latency_ns, ns);
+    note_max(decision_latency_max_ns, ns);
+}
+
+void note_actuation_latency(uint64_t ns)
+{
+    ewma(actuation_latency_ns, ns);
+    note_max(actuation_latency_max_ns, ns);
+}
+
+uint64_t pipeline_latency_ns()
+{
+    double actuation = actuation_latency_ns.load(std::memory_order_relaxed);
+    return uint64_t(actuation > 0 ? actuation : decision_latency_ns.load(std::memory_order_relaxed));
+}
+
+void log_tracker_stats()
+{
+    if (laser_tracker.updates() == 0) return;
+    syslog(LOG_INFO, "Laser Tracker Stats:");
+    syslog(LOG_INFO, "  Measurements / restarts: %llu / %llu",
+           (unsigned long long)laser_tracker.updates(), (unsigned long long)laser_tracker.restarts());
+    syslog(LOG_INFO, "  Capture -> decision    : %.2f ms (max %.2f ms)",
+           decision_latency_ns.load() / 1e6, decision_latency_max_ns.load() / 1e6);
+    syslog(LOG_INFO, "  Capture -> actuation   : %.2f ms (max %.2f ms)",
+           actuation_latency_ns.load() / 1e6, actuation_latency_max_ns.load() / 1e6);
+}
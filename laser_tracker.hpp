@@ -0,0 +1,77 @@
+/***************************************************************
+ * File: laser_tracker.hpp
+ * Description: Alpha-beta filter between the detector and the direction
+ *              decision. Measurements are the detector's sub-pixel
+ *              centroids stamped with the capture time of their frame.
+ *              The filter keeps a position, a velocity and a confidence,
+ *              and predicts where the dot will be when the motor command
+ *              built from it takes effect, using the capture-to-actuation
+ *              latency the motor service measures.
+ ***************************************************************/
+
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include "red_laser_service.hpp"
+
+// position and velocity gains, beta = alpha^2 / (2 - alpha) (Benedict-Bordner)
+#define TRACK_ALPHA 0.5f
+#define TRACK_BETA  0.17f
+// a measurement further than this from the prediction restarts the track
+#define TRACK_GATE_PX 120.0f
+// without a measurement for this long the track is dropped
+#define TRACK_COAST_NS 500000000ull
+// confidence needed before the prediction replaces the measurement
+#define TRACK_MIN_CONFIDENCE 0.5f
+// share of the missing confidence each consistent measurement adds
+#define TRACK_CONFIDENCE_GAIN 0.3f
+// weight of a new sample in the latency averages
+#define LATENCY_EWMA 0.1
+
+struct TrackState {
+    bool valid;
+    float x, y;             // filtered position at t_ns
+    float vx, vy;           // pixels per second
+    float confidence;       // 0..1, fades out over TRACK_COAST_NS without measurements
+    uint64_t t_ns;          // capture time of the last measurement (steady clock)
+    float px, py;           // position extrapolated to predict_ns
+    uint64_t predict_ns;    // expected actuation time of a command issued now
+    int behav;
+    int camera;             // camera of the measurements, see Point2D::camera
+};
+
+class AlphaBetaTracker {
+public:
+    // Fold in one measurement. A point older than or as old as the state
+    // (the change gate hands the same point back) is ignored; returns
+    // false then. A point from another camera than the last one restarts
+    // the track: the offset between two cameras is not motion.
+    bool update(const Point2D& point);
+
+    // State extrapolated to `t_ns`, confidence faded by the age
+    TrackState predict(uint64_t t_ns) const;
+
+    const TrackState& state() const { return _state; }
+
+    uint64_t updates() const { return _updates; }
+    uint64_t restarts() const { return _restarts; }
+
+private:
+    void _restart(const Point2D& point);
+
+    TrackState _state{};
+    uint64_t _updates = 0;
+    uint64_t _restarts = 0;
+};
+
+// Capture-to-decision and capture-to-actuation latency, averaged. The
+// prediction horizon is the actuation latency once the motor service has
+// reported one, the decision latency before that (or without motors).
+void note_decision_latency(uint64_t ns);
+void note_actuation_latency(uint64_t ns);
+uint64_t pipeline_latency_ns();
+
+extern AlphaBetaTracker laser_tracker;
+
+void log_tracker_stats();
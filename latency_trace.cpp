@@ -0,0 +1,125 @@
+/***************************************************************
+ * File: latency_trace.cpp
+ * Description: Per-stage and glass-to-motor latency histograms.
+ ***************************************************************/
+
+#include "latency_trace.hpp"
+
+#include <algorithm>
+#include <bit>
+#include <syslog.h>
+
+static LatencyHistogram trace_histograms[TRACE_SPANS];
+
+static const char* const trace_span_names[TRACE_SPANS] = {
+    "driver queue", "capture", "capture -> detect", "detect", "decide", "actuate",
+    "glass -> decision", "glass -> motor",
+};
+
+static void raise_max(std::atomic<uint64_t>& max, uint64_t ns)
+{
+    uint64_t seen = max.load(std::memory_order_relaxed);
+    while (ns > seen && !max.compare_exchange_weak(seen, ns, std::memory_order_relaxed)) {
+    }
+}
+
+int LatencyHistogram::_bucket(uint64_t us)
+{
+    if (us < LATENCY_SUB_BUCKETS) return int(us);
+    int exp = std::bit_width(us) - 1;       // >= 4
+    int bucket = LATENCY_SUB_BUCKETS + (exp - 4) * LATENCY_SUB_BUCKETS +
+                 int((us >> (exp - 4)) & (LATENCY_SUB_BUCKETS - 1));
+    return bucket < LATENCY_BUCKETS ? bucket : LATENCY_BUCKETS - 1;
+}
+
+uint64_t LatencyHistogram::_upper_ns(int bucket)
+{
+    if (bucket < LATENCY_SUB_BUCKETS) return uint64_t(bucket + 1) * 1000;
+    int exp = (bucket - LATENCY_SUB_BUCKETS) / LATENCY_SUB_BUCKETS + 4;
+    uint64_t sub = (bucket - LATENCY_SUB_BUCKETS) % LATENCY_SUB_BUCKETS;
+    return ((LATENCY_SUB_BUCKETS + sub + 1) << (exp - 4)) * 1000;
+}
+
+void LatencyHistogram::record(uint64_t ns)
+{
+    _buckets[_bucket(ns / 1000)].fetch_add(1, std::memory_order_relaxed);
+    _count.fetch_add(1, std::memory_order_relaxed);
+    raise_max(_max_ns, ns);
+    raise_max(_window_max_ns, ns);
+}
+
+void LatencyHistogram::snapshot(uint32_t (&counts)[LATENCY_BUCKETS]) const
+{
+    for (int b = 0; b < LATENCY_BUCKETS; ++b) counts[b] = _buckets[b].load(std::memory_order_relaxed);
+}
+
+uint64_t LatencyHistogram::percentile(const uint32_t (&counts)[LATENCY_BUCKETS], double p)
+{
+    uint64_t total = 0;
+    for (uint32_t c : counts) total += c;
+    if (total == 0) return 0;
+    uint64_t rank = uint64_t(p * total);
+    if (rank >= total) rank = total - 1;
+    uint64_t seen = 0;
+    for (int b = 0; b < LATENCY_BUCKETS; ++b) {
+        seen += counts[b];
+        if (seen > rank) return _upper_ns(b);
+    }
+    return _upper_ns(LATENCY_BUCKETS - 1);
+}
+
+static void record_span(TraceSpan span, uint64_t from, uint64_t to)
+{
+    if (from && to >= from) trace_histograms[span].record(to - from);
+}
+
+void trace_record(const FrameTrace& t, uint64_t actuated_ns)
+{
+    // a replay or a driver without monotonic stamps starts at dequeue
+    uint64_t glass = t.exposed_ns ? t.exposed_ns : t.dequeued_ns;
+    if (actuated_ns) {
+        record_span(TRACE_ACTUATE, t.decided_ns, actuated_ns);
+        record_span(TRACE_GLASS_TO_MOTOR, glass, actuated_ns);
+        return;
+    }
+    if (t.exposed_ns) record_span(TRACE_DRIVER, t.exposed_ns, t.dequeued_ns);
+    record_span(TRACE_CAPTURE, t.dequeued_ns, t.published_ns);
+    record_span(TRACE_HANDOFF, t.published_ns, t.taken_ns);
+    record_span(TRACE_DETECT, t.taken_ns, t.detected_ns);
+    record_span(TRACE_DECIDE, t.detected_ns, t.decided_ns);
+    record_span(TRACE_GLASS_TO_DECISION, glass, t.decided_ns);
+}
+
+void log_latency_trace(bool interval)
+{
+    // bucket counts at the previous interval summary
+    static uint32_t previous[TRACE_SPANS][LATENCY_BUCKETS];
+
+    bool header = false;
+    for (int s = 0; s < TRACE_SPANS; ++s) {
+        LatencyHistogram& h = trace_histograms[s];
+        uint32_t counts[LATENCY_BUCKETS];
+        h.snapshot(counts);
+        uint64_t max = h.max_ns();
+        if (interval) {
+            for (int b = 0; b < LATENCY_BUCKETS; ++b) {
+                uint32_t now = counts[b];
+                counts[b] -= previous[s][b];
+                previous[s][b] = now;
+            }
+            max = h.takeWindowMax();
+        }
+        uint64_t n = 0;
+        for (uint32_t c : counts) n += c;
+        if (n == 0) continue;
+        if (!header) {
+            syslog(LOG_INFO, "Latency Trace (%s):", interval ? "last interval" : "since start");
+            header = true;
+        }
+        // bucket edges round up, never past the largest sample
+        uint64_t p50 = std::min(LatencyHistogram::percentile(counts, 0.50), max);
+        uint64_t p99 = std::min(LatencyHistogram::percentile(counts, 0.99), max);
+        syslog(LOG_INFO, "  %-18s: %6llu frames, p50 %7.2f ms, p99 %7.2f ms, max %7.2f ms",
+               trace_span_names[s], (unsigned long long)n, p50 / 1e6, p99 / 1e6, max / 1e6);
+    }
+}
@@ -0,0 +1,95 @@
+/***************************************************************
+ * File: latency_trace.hpp
+ * Description: Glass-to-motor latency of each frame. A FrameTrace
+ *              carries the frame's V4L2 sequence and timestamp and a
+ *              stamp from every stage boundary through Point2D and
+ *              MovementCommand down to MotorDriver::drive(). The time
+ *              between consecutive stamps goes into one histogram per
+ *              stage, and exposure to decision or to PWM change into an
+ *              end-to-end histogram.
+ *
+ *              Each histogram has a single writer: service 3 records
+ *              the spans up to its decision, service 4 the actuation
+ *              and the glass-to-motor total. The main thread logs p50,
+ *              p99 and max of the last interval every
+ *              LATENCY_SUMMARY_MS, and the totals on exit.
+ ***************************************************************/
+
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+
+// Interval of the periodic summary
+#define LATENCY_SUMMARY_MS 5000
+
+// The clock of every stamp, also what V4L2 uses for monotonic timestamps
+inline uint64_t steady_ns()
+{
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(
+        std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+// Stamps on the steady clock, 0 where a stage did not set one. A replayed
+// frame's exposure is the time it became due.
+struct FrameTrace {
+    uint32_t sequence = 0;      // v4l2_buffer.sequence
+    uint64_t exposed_ns = 0;    // v4l2_buffer.timestamp, if it is monotonic
+    uint64_t dequeued_ns = 0;   // capture service had it
+    uint64_t published_ns = 0;  // capture service handed it on
+    uint64_t taken_ns = 0;      // detector picked it up
+    uint64_t detected_ns = 0;   // point published
+    uint64_t decided_ns = 0;    // command published
+};
+
+enum TraceSpan {
+    TRACE_DRIVER,           // exposed -> dequeued: waiting in the driver queue
+    TRACE_CAPTURE,          // dequeued -> published
+    TRACE_HANDOFF,          // published -> taken: waiting for the detector
+    TRACE_DETECT,           // taken -> detected
+    TRACE_DECIDE,           // detected -> decided
+    TRACE_ACTUATE,          // decided -> PWM and direction lines set
+    TRACE_GLASS_TO_DECISION,
+    TRACE_GLASS_TO_MOTOR,
+    TRACE_SPANS
+};
+
+// Log-linear buckets: exact below 16 us, then 16 per power of two, so a
+// bucket is at most 1/16 wide relative to its value, up to ~16 s
+#define LATENCY_SUB_BUCKETS 16
+#define LATENCY_BUCKETS (LATENCY_SUB_BUCKETS + 20 * LATENCY_SUB_BUCKETS)
+
+class LatencyHistogram {
+public:
+    void record(uint64_t ns);
+
+    uint64_t count() const { return _count.load(std::memory_order_relaxed); }
+    uint64_t max_ns() const { return _max_ns.load(std::memory_order_relaxed); }
+
+    // Copy the bucket counts, for percentiles over an interval
+    void snapshot(uint32_t (&counts)[LATENCY_BUCKETS]) const;
+    // Largest sample since the last call
+    uint64_t takeWindowMax() { return _window_max_ns.exchange(0, std::memory_order_relaxed); }
+
+    // Upper edge of the bucket holding the p-th fraction of `counts`
+    static uint64_t percentile(const uint32_t (&counts)[LATENCY_BUCKETS], double p);
+
+private:
+    static int _bucket(uint64_t us);
+    static uint64_t _upper_ns(int bucket);
+
+    std::atomic<uint32_t> _buckets[LATENCY_BUCKETS] = {};
+    std::atomic<uint64_t> _count{0};
+    std::atomic<uint64_t> _max_ns{0};
+    std::atomic<uint64_t> _window_max_ns{0};
+};
+
+// Record the spans between the stamps set in `trace`, ending with the
+// command published (`decided_ns`) or, from the motor service, with
+// `actuated_ns` when it is not 0
+void trace_record(const FrameTrace& trace, uint64_t actuated_ns = 0);
+
+// p50/p99/max per span: since the previous call with `interval`, or
+// since start otherwise
+void log_latency_trace(bool interval);
@@ -0,0 +1,97 @@
+/***************************************************************
+ * File: mailbox.hpp
+ * Description: Latest-value mailbox between two pipeline stages, a
+ *              triple buffer. The writer fills its back slot and swaps
+ *              it with the middle one; the reader swaps the middle slot
+ *              with its front slot when the middle one holds something
+ *              newer. Both sides are a copy and one atomic exchange, so
+ *              neither can block or be made to retry by the other.
+ *
+ *              One writer and one reader at a time. Handing either role
+ *              to another thread (main before the sequencer starts, then
+ *              a service) is fine as long as the two do not overlap.
+ *
+ *              Slots, the shared index and each side's bookkeeping sit
+ *              on separate cache lines, so the writer publishing does
+ *              not invalidate the line the reader is polling, and
+ *              neither invalidates a neighbouring global.
+ ***************************************************************/
+
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <syslog.h>
+
+#define MAILBOX_CACHE_LINE 64
+
+template <typename T>
+class Mailbox {
+public:
+    Mailbox() = default;
+
+    // Every slot starts as `initial`, so reads before the first publish
+    // return it (and false)
+    explicit Mailbox(const T& initial)
+    {
+        for (Slot& slot : _slots) slot.value = initial;
+    }
+
+    Mailbox(const Mailbox&) = delete;
+    Mailbox& operator=(const Mailbox&) = delete;
+
+    // Writer: make `value` the newest. A value the reader never saw is
+    // overwritten and counted.
+    void publish(const T& value)
+    {
+        _slots[_back].value = value;
+        uint8_t previous = _middle.exchange(_back | FRESH, std::memory_order_acq_rel);
+        _back = previous & INDEX;
+        _published.store(_published.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+        if (previous & FRESH) {
+            _overwritten.store(_overwritten.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+        }
+    }
+
+    // Reader: copy the newest value into `out`. True if it was published
+    // since the last read; false (counted as stale) if `out` is the value
+    // the reader already had.
+    bool read(T& out)
+    {
+        bool fresh = _middle.load(std::memory_order_relaxed) & FRESH;
+        if (fresh) _front = _middle.exchange(_front, std::memory_order_acq_rel) & INDEX;
+        else _stale.store(_stale.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+        out = _slots[_front].value;
+        return fresh;
+    }
+
+    uint64_t published() const { return _published.load(std::memory_order_relaxed); }
+    uint64_t overwritten() const { return _overwritten.load(std::memory_order_relaxed); }
+    uint64_t stale() const { return _stale.load(std::memory_order_relaxed); }
+
+    void logStats(const char* name) const
+    {
+        syslog(LOG_INFO, "  %-22s: %llu published, %llu overwritten unread, %llu stale reads", name,
+               (unsigned long long)published(), (unsigned long long)overwritten(),
+               (unsigned long long)stale());
+    }
+
+private:
+    static constexpr uint8_t INDEX = 3;
+    static constexpr uint8_t FRESH = 4;
+
+    struct alignas(MAILBOX_CACHE_LINE) Slot {
+        T value{};
+    };
+
+    Slot _slots[3];
+    // index of the middle slot, FRESH while the reader has not taken it
+    alignas(MAILBOX_CACHE_LINE) std::atomic<uint8_t> _middle{1};
+    // writer side
+    alignas(MAILBOX_CACHE_LINE) uint8_t _back = 2;
+    std::atomic<uint64_t> _published{0};
+    std::atomic<uint64_t> _overwritten{0};
+    // reader side
+    alignas(MAILBOX_CACHE_LINE) uint8_t _front = 0;
+    std::atomic<uint64_t> _stale{0};
+};
@@ -1,71 +1,324 @@
-#include <cstdint>	
-#include <cstdio>
-#include <csignal> 
-#include <sys/ioctl.h>
-#include <cstring>
-#include "Sequencer.hpp"
-#include "cameraService.hpp"
-#include "red_laser_service.hpp"
-#include "config_update_service.hpp"
-#include "direction_deciding.hpp"
-#include "motor_control.hpp"
-#include "watchdog.hpp"
-bool stop_requested=false;
-
-
-
-void signal_handler(int signum) {
-    syslog(LOG_INFO, "Interrupt signal (%d) received. Stopping services...", signum);
-    stop_requested = true;
-}
-
-int main() {
-    openlog("LOG_MSG", LOG_PID | LOG_PERROR, LOG_USER);
-
-	//attempt to initalize the camera
-    if (init_camera() != EXIT_SUCCESS) 
-    {
-		syslog(LOG_ERR,"camera failed to setup exiting !");
-		return EXIT_FAILURE;
-	}
-	if (gpioInitialise()<0) {
-		syslog(LOG_ERR,"ERROR");
-		return 1;};
-	
-	signal(SIGINT, signal_handler); // Register handler for Ctrl+C
-	
-	int pwmPin = 18;            
-	int pwmPin1 = 19;
-	int range  = 100;           
-	int freq   = 10;           
-
-	gpioSetPWMfrequency(pwmPin, freq);
-	gpioSetPWMrange(pwmPin, range);
-	gpioSetPWMfrequency(pwmPin1, freq);
-	gpioSetPWMrange(pwmPin1, range);
-
-    Sequencer sequencer{};
-    
-    //service 1 is camera service running at 1000/30 approx 30fpsFco
-    sequencer.addService(camera_capture_service, 1, 98, 30, 1);
-    sequencer.addService(red_laser_detect, 1, 97, 35, 2);
-    sequencer.addService(service3_thread, 1, 96,40, 3);
-    sequencer.addService(motor_control_service, 1, 95, 50, 4);
-    sequencer.addService(config_update_service,2,50,2000,5);
-    //sequencer.addService(watchdog_service, 2, 90, 2500, 6); 
-	//warm up cache?
-    for(int i=0;i<10;i++){
-		camera_capture_service();
-}  
-    sequencer.startServices();
-
-    // Wait until Ctrl+C is pressed
-    while (!stop_requested) {
-        std::this_thread::sleep_for(std::chrono::milliseconds(100));
-    }
-
-    sequencer.stopServices();
-    syslog(LOG_INFO, "Services stopped. Exiting.");
-    return 0;
-}
-
+#include <cstdint>	
+#include <cstdio>
+#include <csignal> 
+#include <sys/ioctl.h>
+#include <cstring>
+#include <algorithm>
+#include <unistd.h>
+#include "Sequencer.hpp"
+#include "cameraService.hpp"
+#include "replay_source.hpp"
+#include "frame_recorder.hpp"
+#include "laser_mask.hpp"
+#include "config_snapshot.hpp"
+#include "detect_stripes.hpp"
+#include "debug_view.hpp"
+#include "red_laser_service.hpp"
+#include "config_update_service.hpp"
+#include "direction_deciding.hpp"
+#include "laser_tracker.hpp"
+#include "latency_trace.hpp"
+#include "laser_pipeline.hpp"
+#include "motor_control.hpp"
+#include "watchdog.hpp"
+bool stop_requested=false;
+
+
+
+void signal_handler(int signum) {
+    syslog(LOG_INFO, "Interrupt signal (%d) received. Stopping services...", signum);
+    stop_requested = true;
+}
+
+static void usage(const char* prog) {
+    fprintf(stderr,
+            "usage: %s [-r recording]... [-D device]... [-a cores] [-m mount]... [-M mode] [-f] [-l] [-R recording] [-N frames] [-d lut|yuyv|bgr] [-k isa] [-F] [-S score] [-W n] [-C cores] [-V sink] [-G n] [-P level] [-T] [-p] [-q] [-B n]\n"
+            "  -r FILE  replay a raw YUYV recording instead of " CAM_DEVICE "\n"
+            "  -D DEV   capture from the V4L2 device DEV\n"
+            "           -r and -D add one camera each, up to %d; the decision follows\n"
+            "           the largest dot any of them sees\n"
+            "  -a LIST  core of each camera's capture and detect stages (default 1,2,3,0)\n"
+            "  -m N:DX,DY[,mirror]\n"
+            "           where camera N's image lies on camera 0's, in 640x480 units;\n"
+            "           every camera has to look the same way as camera 0\n"
+            "  -M MODE  device capture mode: WxH, WxH@FPS or @FPS, optionally with :YUYV\n"
+            "           (default 640x480 at the driver's rate). With FPS the mode that\n"
+            "           reaches it is picked from those the device lists, the largest\n"
+            "           frames first; every service period follows the frame interval\n"
+            "  -f       replay as fast as frames are requested (default: recorded pace)\n"
+            "  -l       loop the recording\n"
+            "  -R FILE  record the first camera's raw frames and V4L2 metadata to FILE\n"
+            "  -N N     frames preallocated for recording (default 900)\n"
+            "  -d PATH  mask path: lut (default), yuyv (exact kernel) or bgr (OpenCV chain)\n"
+            "  -k ISA   yuyv kernel: scalar, sse4.1, avx2 or neon (default: widest supported)\n"
+            "  -F       scan the full frame every time instead of tracking a window\n"
+            "  -S RULE  blob to follow: largest (default), brightest or closest\n"
+            "  -W N     detection stripes per frame, 1-4 (default 1: detector thread only)\n"
+            "  -C LIST  cores for the stripe helpers (default 0,2,3)\n"
+            "  -V SINK  debug view: window, dir:PATH or shm (default: headless)\n"
+            "  -G N     skip detection unless a 32x32 tile's sampled luma sum moved by more\n"
+            "           than N (default %d, 0: detect every frame)\n"
+            "  -P N     full-frame scans coarse-to-fine from a mask sampled once per NxN\n"
+            "           block, 2 or 4 (default 1: off, lut path only)\n"
+            "  -T       release every stage on its own period only (default: a stage is\n"
+            "           also released as soon as its producer published)\n"
+            "  -p       release capture every 0.9 frame intervals to poll the device (default:\n"
+            "           block until each frame lands, two frame intervals deadline)\n"
+            "  -q       take one queued frame per wakeup (default: drain the queue, keep\n"
+            "           the newest)\n"
+            "  -B N     capture buffers, %d-%d (default %d): more absorb stalls, fewer\n"
+            "           bound how stale a queued frame gets\n", prog, MAX_CAMERAS, CHANGE_THRESHOLD_DEFAULT,
+            CAPTURE_BUFFERS_MIN, CAPTURE_BUFFERS_MAX, CAPTURE_BUFFERS_DEFAULT);
+}
+
+int main(int argc, char** argv) {
+    openlog("LOG_MSG", LOG_PID | LOG_PERROR, LOG_USER);
+
+    //one camera per -r or -D, in the order given
+    struct CameraArg {
+        const char* path;
+        bool replay;
+    };
+    std::vector<CameraArg> camera_args;
+    std::vector<int> camera_cores = {1, 2, 3, 0};
+    bool replay_fast = false;
+    bool replay_loop = false;
+    const char* record_path = nullptr;
+    uint32_t record_frames = 900;
+    int stripe_workers = 1;
+    std::vector<int> stripe_cores = {0, 2, 3};
+    StageRelease stage_release = RELEASE_ON_INPUT;
+    int capture_buffers = CAPTURE_BUFFERS_DEFAULT;
+    CaptureProfile capture_profile;
+    struct MountArg {
+        int camera;
+        CameraMount mount;
+    };
+    std::vector<MountArg> mounts;
+    int opt;
+    while ((opt = getopt(argc, argv, "r:D:a:m:M:flR:N:d:k:FS:W:C:V:G:P:TpqB:h")) != -1) {
+        switch (opt) {
+            case 'r': camera_args.push_back({optarg, true});  break;
+            case 'D': camera_args.push_back({optarg, false}); break;
+            case 'a':
+                if (!parse_core_list(optarg, camera_cores)) { usage(argv[0]); return EXIT_FAILURE; }
+                break;
+            case 'm': {
+                MountArg m;
+                if (!parse_camera_mount(optarg, m.camera, m.mount)) { usage(argv[0]); return EXIT_FAILURE; }
+                mounts.push_back(m);
+                break;
+            }
+            case 'M':
+                if (!parse_capture_profile(optarg, capture_profile)) { usage(argv[0]); return EXIT_FAILURE; }
+                break;
+            case 'f': replay_fast = true;   break;
+            case 'l': replay_loop = true;   break;
+            case 'R': record_path = optarg; break;
+            case 'N': record_frames = strtoul(optarg, nullptr, 10); break;
+            case 'd':
+                if (!parse_detect_path(optarg, detect_path)) { usage(argv[0]); return EXIT_FAILURE; }
+                break;
+            case 'k':
+                if (!select_mask_kernel(mask_kernel_from_name(optarg))) return EXIT_FAILURE;
+                break;
+            case 'F': laser_roi_tracking = false; break;
+            case 'S':
+                if (!parse_blob_score(optarg, blob_score)) { usage(argv[0]); return EXIT_FAILURE; }
+                break;
+            case 'W': stripe_workers = atoi(optarg); break;
+            case 'V':
+                if (!debug_view.configure(optarg)) { usage(argv[0]); return EXIT_FAILURE; }
+                break;
+            case 'C':
+                if (!parse_core_list(optarg, stripe_cores)) { usage(argv[0]); return EXIT_FAILURE; }
+                break;
+            case 'G':
+                if (!parse_change_threshold(optarg, change_threshold)) { usage(argv[0]); return EXIT_FAILURE; }
+                break;
+            case 'P':
+                pyramid_level = atoi(optarg);
+                if (pyramid_level != 1 && pyramid_level != 2 && pyramid_level != 4) { usage(argv[0]); return EXIT_FAILURE; }
+                break;
+            case 'T': stage_release = RELEASE_PERIODIC; break;
+            case 'p': capture_wake = CAPTURE_PERIODIC; break;
+            case 'q': capture_drain = false; break;
+            case 'B':
+                capture_buffers = atoi(optarg);
+                if (capture_buffers < CAPTURE_BUFFERS_MIN || capture_buffers > CAPTURE_BUFFERS_MAX) { usage(argv[0]); return EXIT_FAILURE; }
+                break;
+            default:  usage(argv[0]);       return EXIT_FAILURE;
+        }
+    }
+
+    if (camera_args.empty()) camera_args.push_back({CAM_DEVICE, false});
+    if (int(camera_args.size()) > MAX_CAMERAS || camera_cores.size() < camera_args.size()) {
+        usage(argv[0]);
+        return EXIT_FAILURE;
+    }
+    for (const MountArg& m : mounts) {
+        if (m.camera == 0 || m.camera >= int(camera_args.size())) {
+            syslog(LOG_ERR, "-m: camera %d is not a further camera, camera 0 is the reference", m.camera);
+            return EXIT_FAILURE;
+        }
+    }
+    bool all_replays = true;
+    for (const CameraArg& arg : camera_args) all_replays = all_replays && arg.replay;
+
+    //an unpaced replay always has a frame ready, blocking on it would spin
+    //capture at top priority and starve detection on the same core
+    if (!all_replays) replay_fast = false;
+    if (replay_fast && capture_wake == CAPTURE_ON_FRAME) {
+        syslog(LOG_INFO, "unpaced replay, capture released periodically");
+        capture_wake = CAPTURE_PERIODIC;
+    }
+    //the stripe pool serves one detector at a time
+    if (camera_args.size() > 1 && stripe_workers > 1) {
+        syslog(LOG_WARNING, "%zu cameras, detecting without stripe helpers", camera_args.size());
+        stripe_workers = 1;
+    }
+
+    //the debug view and the recorder hold frames of the first camera on top
+    //of the pipeline's, its driver has to be given enough to go on filling
+    int first_buffers = capture_buffers_needed(debug_view.configured(), record_path != nullptr);
+    if (first_buffers > capture_buffers && !camera_args[0].replay) {
+        syslog(LOG_WARNING, "first camera: %d capture buffers instead of %d, the debug view and "
+               "recorder hold frames too", first_buffers, capture_buffers);
+    } else {
+        first_buffers = capture_buffers;
+    }
+
+    //the pipeline's channels, wired into stages below
+    LaserChannels channels(camera_args.size());
+    //one decision frame: the other cameras' points are moved onto camera 0's image
+    for (const MountArg& m : mounts) channels.fusion.mount(m.camera, m.mount);
+    if (camera_args.size() > 1) {
+        syslog(LOG_INFO, "%zu cameras, steering in camera 0's image: all must face the same way, "
+               "%zu mapped with -m", camera_args.size(), mounts.size());
+    }
+
+	//attempt to initalize the cameras
+    for (size_t i = 0; i < camera_args.size(); ++i) {
+        std::unique_ptr<FrameSource> source;
+        if (camera_args[i].replay) {
+            source = std::make_unique<ReplaySource>(camera_args[i].path, !replay_fast, replay_loop);
+        } else {
+            source = std::make_unique<V4L2Source>(camera_args[i].path, i == 0 ? first_buffers : capture_buffers,
+                                                  capture_profile);
+        }
+        CameraPipeline& cam = *channels.cameras[i];
+        cam.core = camera_cores[i];
+        if (cam.camera.open(std::move(source), cam.frames) != EXIT_SUCCESS)
+        {
+            syslog(LOG_ERR,"camera %zu failed to setup exiting !", i);
+            return EXIT_FAILURE;
+        }
+    }
+    Camera& first_camera = channels.cameras.front()->camera;
+	if (record_path) {
+		if (frame_recorder.open(record_path, record_frames, first_camera.format()) != EXIT_SUCCESS) {
+			syslog(LOG_ERR,"recorder failed to setup exiting !");
+			return EXIT_FAILURE;
+		}
+		frame_recorder.start(RECORDER_CPU);
+		first_camera.record(&frame_recorder);
+	}
+	//a replay can run on a dev box without the motor hat
+	bool motors = true;
+	if (gpioInitialise()<0) {
+		if (!all_replays) {
+			syslog(LOG_ERR,"ERROR");
+			return 1;
+		}
+		syslog(LOG_WARNING,"pigpio unavailable, replaying without motors");
+		motors = false;
+	}
+	
+	signal(SIGINT, signal_handler); // Register handler for Ctrl+C
+	
+	int pwmPin = 18;            
+	int pwmPin1 = 19;
+	int range  = 100;           
+	int freq   = 10;           
+
+	if (motors) {
+	gpioSetPWMfrequency(pwmPin, freq);
+	gpioSetPWMrange(pwmPin, range);
+	gpioSetPWMfrequency(pwmPin1, freq);
+	gpioSetPWMrange(pwmPin1, range);
+	}
+
+    //snapshot of the default thresholds, until the config service loads Config.json
+    config_store.publish(HSVConfig{});
+    //cameras that are not running never take a snapshot
+    for (int i = channels.cameras.size(); i < MAX_CAMERAS; ++i) {
+        config_store.retire(camera_reader(CONFIG_READER_CAPTURE, i));
+        config_store.retire(camera_reader(CONFIG_READER_DETECT, i));
+    }
+    //stripe helpers sit on the cores the pipeline leaves idle
+    if (stripe_workers > 1) stripe_pool.configure(stripe_workers, stripe_cores);
+    //debug frames are drawn by a SCHED_OTHER thread, never by the detector
+    debug_view.start(DEBUG_VIEW_CPU);
+
+    Sequencer sequencer{};
+    
+    //capture, detect, decide and motors on core 1 as services 1..4, the
+    //producer of each channel above its consumer (98, 97, 96, 95). Each
+    //consumer runs when its producer publishes, so a frame reaches the
+    //motors in the sum of the execution times instead of waiting out
+    //three unaligned periods. Every further camera adds its capture and
+    //detect on its own core and a fusion stage ahead of decide.
+    Pipeline pipeline;
+    build_laser_pipeline(pipeline, channels, motors);
+    if (!pipeline.schedule(sequencer, 1, 98, 1, stage_release)) {
+        syslog(LOG_ERR,"pipeline wiring invalid exiting !");
+        return EXIT_FAILURE;
+    }
+    //blocks on inotify events instead of polling the file; service 5 unless
+    //more cameras push the pipeline's identifiers past it
+    sequencer.addService(config_update_service,2,50,-1,std::max(5, pipeline.size() + 1));
+    //sequencer.addService(watchdog_service, 2, 90, 2500, 6); 
+	//warm up cache?
+    for (auto& cam : channels.cameras) {
+        for(int i=0;i<10;i++){
+            cam->camera.capture(cam->frames, cam->detector.fullScanNext());
+        }
+    }
+    sequencer.startServices();
+
+    // Wait until Ctrl+C is pressed, summing up latency now and then
+    auto next_summary = std::chrono::steady_clock::now() + std::chrono::milliseconds(LATENCY_SUMMARY_MS);
+    auto all_finished = [&channels] {
+        for (auto& cam : channels.cameras) {
+            if (!cam->camera.finished()) return false;
+        }
+        return true;
+    };
+    while (!stop_requested && !all_finished()) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(100));
+        if (std::chrono::steady_clock::now() >= next_summary) {
+            log_latency_trace(true);
+            next_summary += std::chrono::milliseconds(LATENCY_SUMMARY_MS);
+        }
+    }
+
+    sequencer.stopServices();
+    frame_recorder.stop();
+    stripe_pool.stop();
+    debug_view.stop();
+    config_store.logStats();
+    log_config_reload_stats();
+    log_frame_copy_stats();
+    for (auto& cam : channels.cameras) cam->camera.logStats();
+    channels.fusion.logStats();
+    log_laser_track_stats();
+    log_change_gate_stats();
+    log_pyramid_stats();
+    log_tracker_stats();
+    log_latency_trace(false);
+    pipeline.logStats();
+    log_lock_stats();
+    syslog(LOG_INFO, "Services stopped. Exiting.");
+    return 0;
+}
+
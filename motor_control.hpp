@@ -17,5 +17,5 @@
 bool motor_driver_init();
 
 // Main service function for motor control
-// This reads MovementCommand and drives motors accordingly
-void motor_control_service();
+// This reads MovementCommand from `commands` and drives motors accordingly
+void motor_control_service(Channel<MovementCommand>& commands);
@@ -0,0 +1,97 @@
+/***************************************************************
+ * File: pi_mutex.cpp
+ * Description: Priority-inheritance mutex and its wait statistics.
+ ***************************************************************/
+
+#include "pi_mutex.hpp"
+
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <syslog.h>
+
+thread_local int lock_service_id = 0;
+
+// every live PiMutex, for log_lock_stats()
+static std::atomic<PiMutex*> lock_registry[LOCK_STAT_MAX_LOCKS];
+
+PiMutex::PiMutex(const char* name) : _name(name)
+{
+    pthread_mutexattr_t attr;
+    pthread_mutexattr_init(&attr);
+    int rc = pthread_mutexattr_setprotocol(&attr, PTHREAD_PRIO_INHERIT);
+    if (rc != 0) {
+        syslog(LOG_WARNING, "lock %s: no priority inheritance (%s)", name, strerror(rc));
+    }
+    pthread_mutex_init(&_mutex, &attr);
+    pthread_mutexattr_destroy(&attr);
+
+    for (auto& slot : lock_registry) {
+        PiMutex* expected = nullptr;
+        if (slot.compare_exchange_strong(expected, this)) return;
+    }
+    syslog(LOG_WARNING, "lock %s: more than %d locks, not in the lock stats", name, LOCK_STAT_MAX_LOCKS);
+}
+
+PiMutex::~PiMutex()
+{
+    for (auto& slot : lock_registry) {
+        PiMutex* expected = this;
+        if (slot.compare_exchange_strong(expected, nullptr)) break;
+    }
+    pthread_mutex_destroy(&_mutex);
+}
+
+void PiMutex::lock()
+{
+    // uncontended: no clock reads
+    if (pthread_mutex_trylock(&_mutex) == 0) return;
+
+    auto t0 = std::chrono::steady_clock::now();
+    int rc = pthread_mutex_lock(&_mutex);
+    uint64_t waited = std::chrono::duration_cast<std::chrono::nanoseconds>(
+        std::chrono::steady_clock::now() - t0).count();
+    if (rc != 0) {
+        syslog(LOG_ERR, "lock %s: pthread_mutex_lock failed (%s)", _name, strerror(rc));
+        return;
+    }
+
+    int service = lock_service_id > 0 && lock_service_id < LOCK_STAT_SERVICES ? lock_service_id : 0;
+    _contended[service].fetch_add(1, std::memory_order_relaxed);
+    uint64_t longest = _max_blocked_ns[service].load(std::memory_order_relaxed);
+    while (waited > longest &&
+           !_max_blocked_ns[service].compare_exchange_weak(longest, waited, std::memory_order_relaxed)) {
+    }
+}
+
+bool PiMutex::try_lock()
+{
+    return pthread_mutex_trylock(&_mutex) == 0;
+}
+
+void PiMutex::unlock()
+{
+    pthread_mutex_unlock(&_mutex);
+}
+
+void log_lock_stats()
+{
+    bool header = false;
+    for (auto& slot : lock_registry) {
+        PiMutex* m = slot.load();
+        if (!m) continue;
+        for (int s = 0; s < LOCK_STAT_SERVICES; ++s) {
+            if (m->contended(s) == 0) continue;
+            if (!header) {
+                syslog(LOG_INFO, "Lock Wait Stats:");
+                header = true;
+            }
+            char who[16];
+            if (s) snprintf(who, sizeof(who), "service %d", s);
+            else snprintf(who, sizeof(who), "other");
+            syslog(LOG_INFO, "  %-14s %-10s: %llu contended, max blocked %.3f ms", m->name(), who,
+                   (unsigned long long)m->contended(s), m->maxBlockedNs(s) / 1e6);
+        }
+    }
+    if (!header) syslog(LOG_INFO, "Lock Wait Stats: no contended locks");
+}
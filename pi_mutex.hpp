@@ -0,0 +1,58 @@
+/***************************************************************
+ * File: pi_mutex.hpp
+ * Description: Mutex for state shared between services of different
+ *              priority. It is a PTHREAD_PRIO_INHERIT pthread mutex, so a
+ *              low-priority holder runs at the priority of the highest
+ *              waiter until it unlocks and a middle-priority service
+ *              cannot preempt it in between. Drop-in for std::mutex with
+ *              std::lock_guard and std::unique_lock.
+ *
+ *              Every lock() that finds the mutex taken is timed. Each
+ *              mutex keeps the longest wait per service (the Sequencer
+ *              tags its threads with their service identifier), so an
+ *              inversion shows up in log_lock_stats() rather than as
+ *              unexplained jitter in the service stats.
+ ***************************************************************/
+
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <pthread.h>
+
+// waits are recorded per service identifier 1..LOCK_STAT_SERVICES-1,
+// slot 0 collects every thread the Sequencer did not start. Room for the
+// laser pipeline with every camera and the service after it, see
+// LASER_PIPELINE_MAX_STAGES
+#define LOCK_STAT_SERVICES 16
+#define LOCK_STAT_MAX_LOCKS 16
+
+// identifier of the Sequencer service running on this thread, 0 elsewhere
+extern thread_local int lock_service_id;
+
+class PiMutex {
+public:
+    explicit PiMutex(const char* name);
+    ~PiMutex();
+
+    PiMutex(const PiMutex&) = delete;
+    PiMutex& operator=(const PiMutex&) = delete;
+
+    void lock();
+    bool try_lock();
+    void unlock();
+
+    const char* name() const { return _name; }
+    uint64_t maxBlockedNs(int service) const { return _max_blocked_ns[service].load(std::memory_order_relaxed); }
+    uint64_t contended(int service) const { return _contended[service].load(std::memory_order_relaxed); }
+
+private:
+    pthread_mutex_t _mutex;
+    const char* _name;
+    std::atomic<uint64_t> _max_blocked_ns[LOCK_STAT_SERVICES]{};
+    std::atomic<uint64_t> _contended[LOCK_STAT_SERVICES]{};
+};
+
+// Longest wait and number of contended acquisitions of every PiMutex,
+// per service that ever had to wait
+void log_lock_stats();
@@ -0,0 +1,166 @@
+/***************************************************************
+ * File: pipeline.cpp
+ * Description: Frame channel, graph validation and scheduling.
+ ***************************************************************/
+
+#include "pipeline.hpp"
+#include "Sequencer.hpp"
+
+#include <algorithm>
+#include <mutex>
+#include <syslog.h>
+
+void ChannelBase::_published()
+{
+    if (_writer) _writer->produced();
+}
+
+void FrameChannel::publish(FrameHandle& frame)
+{
+    bool replaced;
+    {
+        std::lock_guard<PiMutex> lock(_mutex);
+        std::swap(_latest, frame);
+        replaced = !frame.empty();
+    }
+    _frames.fetch_add(1, std::memory_order_relaxed);
+    if (replaced) _replaced.fetch_add(1, std::memory_order_relaxed);
+    _published();
+}
+
+bool FrameChannel::take(FrameHandle& out)
+{
+    std::lock_guard<PiMutex> lock(_mutex);
+    if (_latest.empty()) return false;
+    out = std::move(_latest);
+    return true;
+}
+
+void FrameChannel::reset()
+{
+    FrameHandle old;
+    std::lock_guard<PiMutex> lock(_mutex);
+    std::swap(_latest, old);
+}
+
+void FrameChannel::logStats() const
+{
+    syslog(LOG_INFO, "  %-22s: %llu published, %llu released untaken", name(),
+           (unsigned long long)_frames.load(), (unsigned long long)_replaced.load());
+}
+
+Stage& Stage::reads(ChannelBase& channel)
+{
+    _inputs.push_back(&channel);
+    return *this;
+}
+
+Stage& Stage::writes(ChannelBase& channel)
+{
+    _outputs.push_back(&channel);
+    return *this;
+}
+
+Stage& Stage::core(int core)
+{
+    _core = core;
+    return *this;
+}
+
+Stage& Pipeline::add(const char* name, int period_ms, std::function<void()> run)
+{
+    _stages.push_back(std::unique_ptr<Stage>(new Stage(name, period_ms, std::move(run))));
+    return *_stages.back();
+}
+
+std::vector<ChannelBase*> Pipeline::_channels() const
+{
+    std::vector<ChannelBase*> channels;
+    for (const auto& stage : _stages) {
+        for (const auto* list : {&stage->_outputs, &stage->_inputs}) {
+            for (ChannelBase* c : *list) {
+                if (std::find(channels.begin(), channels.end(), c) == channels.end()) channels.push_back(c);
+            }
+        }
+    }
+    return channels;
+}
+
+bool Pipeline::validate() const
+{
+    bool ok = true;
+    for (ChannelBase* c : _channels()) {
+        int writers = 0, readers = 0;
+        for (const auto& stage : _stages) {
+            writers += std::count(stage->_outputs.begin(), stage->_outputs.end(), c);
+            readers += std::count(stage->_inputs.begin(), stage->_inputs.end(), c);
+        }
+        if (writers != 1) {
+            syslog(LOG_ERR, "pipeline: channel %s has %d writers, needs exactly one", c->name(), writers);
+            ok = false;
+        }
+        if (readers > 1) {
+            syslog(LOG_ERR, "pipeline: channel %s has %d readers, at most one", c->name(), readers);
+            ok = false;
+        }
+    }
+    if (ok && order().size() != _stages.size()) {
+        syslog(LOG_ERR, "pipeline: the stages form a cycle");
+        ok = false;
+    }
+    return ok;
+}
+
+std::vector<Stage*> Pipeline::order() const
+{
+    // repeatedly take the first stage none of whose inputs is written by
+    // a stage still waiting
+    std::vector<Stage*> waiting, sorted;
+    for (const auto& stage : _stages) waiting.push_back(stage.get());
+    while (!waiting.empty()) {
+        auto ready = std::find_if(waiting.begin(), waiting.end(), [&](Stage* s) {
+            for (ChannelBase* in : s->_inputs) {
+                for (Stage* other : waiting) {
+                    if (other != s && std::count(other->_outputs.begin(), other->_outputs.end(), in)) return false;
+                }
+            }
+            return true;
+        });
+        if (ready == waiting.end()) return {};
+        sorted.push_back(*ready);
+        waiting.erase(ready);
+    }
+    return sorted;
+}
+
+bool Pipeline::schedule(Sequencer& sequencer, int core, int top_priority, int first_id,
+                        StageRelease release)
+{
+    if (!validate()) return false;
+    int priority = top_priority;
+    int id = first_id;
+    for (Stage* stage : order()) {
+        int stage_core = stage->_core >= 0 ? stage->_core : core;
+        if (stage->_period > 0) {
+            syslog(LOG_INFO, "pipeline: %s as service %d on core %d, priority %d, period %d ms%s",
+                   stage->_name, id, stage_core, priority, stage->_period,
+                   release == RELEASE_ON_INPUT && !stage->_inputs.empty() ? " or on input" : "");
+        } else {
+            syslog(LOG_INFO, "pipeline: %s as service %d on core %d, priority %d, free-running",
+                   stage->_name, id, stage_core, priority);
+        }
+        Service& service = sequencer.addService(stage->_run, stage_core, priority--, stage->_period, id++);
+        for (ChannelBase* out : stage->_outputs) out->_writer = &service;
+        // writers come first in order(), so every input's writer is known
+        if (release == RELEASE_ON_INPUT) {
+            for (ChannelBase* in : stage->_inputs) in->_writer->precedes(service);
+        }
+    }
+    return true;
+}
+
+void Pipeline::logStats() const
+{
+    syslog(LOG_INFO, "Pipeline Channel Stats:");
+    for (ChannelBase* c : _channels()) c->logStats();
+}
@@ -0,0 +1,160 @@
+/***************************************************************
+ * File: pipeline.hpp
+ * Description: Typed channels between the pipeline stages and the
+ *              graph that wires them. Every stage declares the channels
+ *              it reads and writes, so the wiring lives in one place
+ *              (laser_pipeline.cpp) instead of in extern globals.
+ *              Pipeline::schedule() hands the stages to the Sequencer in
+ *              dependency order, producers first, and can chain them so a
+ *              stage is released as soon as its producer published.
+ *
+ *              Each channel has one writer and one reader. The graph
+ *              checks this at start-up because a Mailbox is only
+ *              wait-free for a single reader. Every channel counts its
+ *              traffic the same way and Pipeline::logStats() logs all of
+ *              them.
+ ***************************************************************/
+
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <vector>
+#include "frame_ring.hpp"
+#include "mailbox.hpp"
+#include "pi_mutex.hpp"
+
+class Sequencer;
+class Service;
+
+// How Pipeline::schedule() releases the stages that read a channel
+enum StageRelease {
+    RELEASE_PERIODIC,   // each stage on its own period, as before
+    RELEASE_ON_INPUT    // when a producer completes with new data; the
+                        // period only applies if none did for that long
+};
+
+class ChannelBase {
+public:
+    explicit ChannelBase(const char* name) : _name(name) {}
+    virtual ~ChannelBase() = default;
+
+    ChannelBase(const ChannelBase&) = delete;
+    ChannelBase& operator=(const ChannelBase&) = delete;
+
+    const char* name() const { return _name; }
+    virtual void logStats() const = 0;
+
+protected:
+    // Tell the writing service it produced something this run
+    void _published();
+
+private:
+    friend class Pipeline;
+    const char* _name;
+    Service* _writer = nullptr;     // set by Pipeline::schedule()
+};
+
+// Latest value wins: a Mailbox, read() returns false when nothing was
+// published since the previous read
+template <typename T>
+class Channel : public ChannelBase {
+public:
+    explicit Channel(const char* name) : ChannelBase(name) {}
+
+    void publish(const T& value)
+    {
+        _box.publish(value);
+        _published();
+    }
+    bool read(T& out) { return _box.read(out); }
+
+    void logStats() const override { _box.logStats(name()); }
+
+private:
+    Mailbox<T> _box;
+};
+
+// Frames change hands instead of being copied: the consumer takes the
+// newest handle and the capture buffer stays out of the driver queue
+// until it lets go. A frame nobody took is released when the next one
+// replaces it.
+class FrameChannel : public ChannelBase {
+public:
+    explicit FrameChannel(const char* name) : ChannelBase(name), _mutex(name) {}
+
+    // Swap `frame` in; `frame` comes back holding the untaken one, if any,
+    // so it is released outside the lock
+    void publish(FrameHandle& frame);
+
+    // Move the newest frame into `out`, false if there is none
+    bool take(FrameHandle& out);
+
+    // Drop an untaken frame (its source is about to go away)
+    void reset();
+
+    void logStats() const override;
+
+private:
+    PiMutex _mutex;
+    FrameHandle _latest;
+    std::atomic<uint64_t> _frames{0};
+    std::atomic<uint64_t> _replaced{0};     // released without being taken
+};
+
+class Stage {
+public:
+    Stage& reads(ChannelBase& channel);
+    Stage& writes(ChannelBase& channel);
+    // Run on `core` instead of the one passed to Pipeline::schedule()
+    Stage& core(int core);
+
+    const char* name() const { return _name; }
+    int period() const { return _period; }
+
+private:
+    friend class Pipeline;
+    Stage(const char* name, int period, std::function<void()> run)
+        : _name(name), _period(period), _run(std::move(run)) {}
+
+    const char* _name;
+    int _period;
+    int _core = -1;                 // -1: the pipeline's core
+    std::function<void()> _run;
+    std::vector<ChannelBase*> _inputs, _outputs;
+};
+
+class Pipeline {
+public:
+    // Declare a stage released every `period_ms`; wire it with reads()/writes()
+    Stage& add(const char* name, int period_ms, std::function<void()> run);
+
+    // Every channel has exactly one writer and at most one reader, and the
+    // stages have no cycle. Logs each violation.
+    bool validate() const;
+
+    // Stages sorted so every writer comes before the readers of its
+    // channels, in declaration order otherwise; empty if there is a cycle
+    std::vector<Stage*> order() const;
+
+    int size() const { return int(_stages.size()); }
+
+    // Add the stages to `sequencer`, on `core` unless a stage was given its
+    // own with Stage::core(), in order(). Each stage
+    // gets a lower priority than the one before it, counting down from
+    // `top_priority`. Service identifiers count up from `first_id`. With
+    // RELEASE_ON_INPUT every writer precedes the readers of its channels.
+    // Returns false, having added nothing, if validate() fails.
+    bool schedule(Sequencer& sequencer, int core, int top_priority, int first_id,
+                  StageRelease release = RELEASE_ON_INPUT);
+
+    // Stats of every channel in the graph
+    void logStats() const;
+
+private:
+    std::vector<ChannelBase*> _channels() const;
+
+    std::vector<std::unique_ptr<Stage>> _stages;
+};
@@ -0,0 +1,102 @@
+/***************************************************************
+ * File: point_fusion.cpp
+ * Description: Selection of one laser point out of several cameras.
+ ***************************************************************/
+
+#include "point_fusion.hpp"
+
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+#include <syslog.h>
+
+bool parse_camera_mount(const char* spec, int& camera, CameraMount& mount)
+{
+    CameraMount m;
+    int end = 0;
+    if (sscanf(spec, "%d:%f,%f%n", &camera, &m.dx, &m.dy, &end) != 3) return false;
+    if (spec[end] == ',') {
+        if (strcmp(spec + end + 1, "mirror") != 0) return false;
+        m.mirror = true;
+    } else if (spec[end] != '\0') {
+        return false;
+    }
+    if (camera < 0 || camera >= MAX_CAMERAS) return false;
+    mount = m;
+    return true;
+}
+
+// When the camera last confirmed the point: a point the change gate hands
+// on again keeps its t_ns but carries the frame it was confirmed on
+static uint64_t seen_ns(const Point2D& p)
+{
+    return p.trace.dequeued_ns ? p.trace.dequeued_ns : p.t_ns;
+}
+
+void PointFusion::fuse(const std::vector<Channel<Point2D>*>& inputs, Channel<Point2D>& out)
+{
+    _runs.fetch_add(1, std::memory_order_relaxed);
+    int count = std::min<int>(inputs.size(), MAX_CAMERAS);
+    bool fresh[MAX_CAMERAS] = {};
+    for (int c = 0; c < count; ++c) {
+        Point2D point;
+        if (inputs[c]->read(point)) {
+            _latest[c] = {true, point};
+            fresh[c] = true;
+        }
+    }
+
+    // largest recent blob, the newest one on a tie
+    uint64_t now = steady_ns();
+    uint64_t max_age = uint64_t(FUSION_MAX_AGE_MS) * 1000000;
+    int best = -1;
+    for (int c = 0; c < count; ++c) {
+        const Latest& l = _latest[c];
+        if (!l.valid || now - seen_ns(l.point) > max_age) continue;
+        if (best < 0 || l.point.area > _latest[best].point.area ||
+            (l.point.area == _latest[best].point.area && seen_ns(l.point) > seen_ns(_latest[best].point))) {
+            best = c;
+        }
+    }
+    if (best < 0) return;
+
+    // keep the current camera while it still sees the dot and nobody sees
+    // it much better
+    if (_selected >= 0 && _selected != best) {
+        const Latest& current = _latest[_selected];
+        if (current.valid && now - seen_ns(current.point) <= max_age &&
+            _latest[best].point.area < current.point.area * FUSION_SWITCH_RATIO) {
+            best = _selected;
+        } else {
+            _switches.fetch_add(1, std::memory_order_relaxed);
+        }
+    }
+    _selected = best;
+
+    // the decision consumes each point once
+    if (!fresh[best]) {
+        _stale.fetch_add(1, std::memory_order_relaxed);
+        return;
+    }
+    _published[best].fetch_add(1, std::memory_order_relaxed);
+    Point2D point = _latest[best].point;
+    const CameraMount& mount = _mounts[best];
+    if (mount.mirror) point.x = POINT_FRAME_WIDTH - point.x;
+    point.x += mount.dx;
+    point.y += mount.dy;
+    out.publish(point);
+}
+
+void PointFusion::logStats() const
+{
+    uint64_t runs = _runs.load();
+    if (runs == 0) return;
+    syslog(LOG_INFO, "Point Fusion Stats:");
+    syslog(LOG_INFO, "  Runs / camera switches: %llu / %llu, %llu without a new point from the chosen camera",
+           (unsigned long long)runs, (unsigned long long)_switches.load(),
+           (unsigned long long)_stale.load());
+    for (int c = 0; c < MAX_CAMERAS; ++c) {
+        uint64_t n = _published[c].load();
+        if (n) syslog(LOG_INFO, "  Camera %d points       : %llu", c, (unsigned long long)n);
+    }
+}
@@ -0,0 +1,79 @@
+/***************************************************************
+ * File: point_fusion.hpp
+ * Description: Picks the laser point the decision service follows
+ *              when several cameras look for it. Each camera's detector
+ *              publishes its own Point2D; the fusion stage keeps the
+ *              newest one of every camera and hands on the largest blob
+ *              seen recently. It stays on the camera it picked last
+ *              unless another one sees a clearly larger blob, so the
+ *              decision does not flip between two cameras that see the
+ *              dot about equally well.
+ *
+ *              The decision has one frame of reference, camera 0's
+ *              image. Every camera has to look the same way as camera 0
+ *              (a stereo pair, a wide and a narrow lens side by side);
+ *              its CameraMount moves its points onto camera 0's image
+ *              before they are handed on. A camera looking elsewhere,
+ *              to the rear say, cannot be mapped onto it and is not
+ *              supported.
+ *
+ *              Runs as its own stage after the detectors and before
+ *              decide; with one camera the stage is left out and the
+ *              detector feeds decide directly.
+ ***************************************************************/
+
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <vector>
+#include "frame_source.hpp"
+#include "pipeline.hpp"
+#include "red_laser_service.hpp"
+
+// A camera's point older than this is not considered, it lost the dot
+#define FUSION_MAX_AGE_MS 100
+
+// Another camera takes over only with this much more blob area
+#define FUSION_SWITCH_RATIO 1.5f
+
+// Where a camera's image lies on camera 0's, in POINT_FRAME_WIDTH x
+// POINT_FRAME_HEIGHT units: mirrored left to right first if it is mounted
+// flipped, then shifted by (dx, dy)
+struct CameraMount {
+    float dx = 0;
+    float dy = 0;
+    bool mirror = false;
+};
+
+// "N:DX,DY" or "N:DX,DY,mirror" for camera N, false if malformed
+bool parse_camera_mount(const char* spec, int& camera, CameraMount& mount);
+
+class PointFusion {
+public:
+    // Before the stages run
+    void mount(int camera, const CameraMount& mount) { _mounts[camera] = mount; }
+
+    // Read every camera's newest point from `inputs` (camera i at index i)
+    // and publish the chosen one to `out`, mapped onto camera 0's image.
+    // Nothing is published unless the chosen camera had a new point this
+    // run. `camera` stays the camera that saw it, so the tracker can tell
+    // a switch from motion.
+    void fuse(const std::vector<Channel<Point2D>*>& inputs, Channel<Point2D>& out);
+
+    void logStats() const;
+
+private:
+    struct Latest {
+        bool valid = false;
+        Point2D point{};
+    };
+    CameraMount _mounts[MAX_CAMERAS];
+    Latest _latest[MAX_CAMERAS];
+    int _selected = -1;
+
+    std::atomic<uint64_t> _runs{0};
+    std::atomic<uint64_t> _published[MAX_CAMERAS] = {};
+    std::atomic<uint64_t> _switches{0};
+    std::atomic<uint64_t> _stale{0};        // chosen camera had nothing new
+};
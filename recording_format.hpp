@@ -0,0 +1,58 @@
+/***************************************************************
+ * File: recording_format.hpp
+ * Description: On-disk layout of a raw YUYV recording.
+ *
+ *   [RecordingHeader][RecordingIndexEntry x capacity][pad]
+ *   [frame 0][frame 1] ... [frame capacity-1]
+ *
+ *              The file is preallocated for `capacity` frames and
+ *              `count` says how many were actually written, so it can
+ *              be filled append-only through a memory mapping.
+ *              Frames start at a page aligned offset.
+ ***************************************************************/
+
+#pragma once
+
+#include <cstdint>
+#include <cstring>
+
+#define RECORDING_MAGIC "YUYVREC1"
+#define RECORDING_VERSION 1
+
+struct RecordingHeader {
+    char magic[8];
+    uint32_t version;
+    uint32_t pixelformat;       // V4L2_PIX_FMT_YUYV
+    uint32_t width;
+    uint32_t height;
+    uint32_t stride;            // bytes per line
+    uint32_t frame_bytes;       // size of one frame slot in the file
+    uint32_t capacity;          // frames preallocated
+    uint32_t count;             // frames written so far
+    uint64_t data_offset;       // file offset of frame 0
+};
+
+// Per-frame metadata copied from the v4l2_buffer at dequeue time
+struct RecordingIndexEntry {
+    uint64_t timestamp_us;
+    uint32_t sequence;
+    uint32_t bytesused;
+};
+
+inline uint64_t recording_data_offset(uint32_t capacity, uint64_t page_size)
+{
+    uint64_t index_end = sizeof(RecordingHeader) + uint64_t(capacity) * sizeof(RecordingIndexEntry);
+    return (index_end + page_size - 1) / page_size * page_size;
+}
+
+// Consistent on its own: the index fits before the frames and a frame slot
+// holds `height` lines of at least two bytes per pixel. Whether the file
+// is long enough is up to the reader.
+inline bool recording_header_valid(const RecordingHeader& h)
+{
+    return std::memcmp(h.magic, RECORDING_MAGIC, sizeof(h.magic)) == 0 &&
+           h.version == RECORDING_VERSION && h.count <= h.capacity &&
+           h.width > 0 && h.height > 0 && uint64_t(h.stride) >= uint64_t(h.width) * 2 &&
+           uint64_t(h.frame_bytes) >= uint64_t(h.stride) * h.height &&
+           h.data_offset >= recording_data_offset(h.capacity, 1);
+}
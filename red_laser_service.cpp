@@ -1,152 +1,412 @@
-#include "red_laser_service.hpp"
-#include <optional>
-//default config
-#include "watchdog.hpp"
-
-
-HSVConfig config; 
-std::mutex config_mutex;
-
-std::optional<Point2D> latest_laser_point;
-std::mutex point_mutex;
-std::atomic<bool>     point_available{false};
-
-    int delta_t(struct timespec *stop, struct timespec *start, struct timespec *delta_t)
-    {
-        int dt_sec = stop->tv_sec - start->tv_sec;
-        int dt_nsec = stop->tv_nsec - start->tv_nsec;
-
-        if (dt_sec >= 0)
-        {
-            if (dt_nsec >= 0)
-            {
-                delta_t->tv_sec = dt_sec;
-                delta_t->tv_nsec = dt_nsec;
-            }
-            else
-            {
-                delta_t->tv_sec = dt_sec - 1;
-                delta_t->tv_nsec = NSEC_PER_SEC + dt_nsec;
-            }
-        }
-        else
-        {
-            if (dt_nsec >= 0)
-            {
-                delta_t->tv_sec = dt_sec;
-                delta_t->tv_nsec = dt_nsec;
-            }
-            else
-            {
-                delta_t->tv_sec = dt_sec - 1;
-                delta_t->tv_nsec = NSEC_PER_SEC + dt_nsec;
-            }
-        }
-
-        return (1);
-    }
-    
-
-
-void thresholdImage(cv::Mat& channel, int minimum, int maximum) {
-    cv::Mat tmp;
-
-    // First threshold with THRESH_TOZERO_INV (sets values above maximum to 0)
-    cv::threshold(channel, tmp, maximum, 0, cv::THRESH_TOZERO_INV);
-
-    // Second threshold with THRESH_BINARY (sets values above minimum to 255)
-    cv::threshold(tmp, channel, minimum, 255, cv::THRESH_BINARY);
-}
-
-void red_laser_detect (){
-	
-	    
-    cv::Mat frame;
-
-    {
-        std::lock_guard<std::mutex> lock(frame_mutex);
-        if (latest_frame.empty()) return;
-        frame = latest_frame.clone();
-    }
-    
-    HSVConfig current_config;
-//get latest config in case if its updated
-{
-    std::lock_guard<std::mutex> lock(config_mutex);
-    current_config = config;
-
-}
-    //most execution overhead due to this 
-//clock_gettime(CLOCK_REALTIME, &start);
-    // Convert to HSV
-    cv::Mat hsv;
-    cv::cvtColor(frame, hsv, cv::COLOR_BGR2HSV);
-
-    // Split the image into individual HSV channels
-    std::vector<cv::Mat> hsv_channels;
-    cv::split(hsv, hsv_channels);
-
-    cv::Mat hue = hsv_channels[0];
-    cv::Mat saturation = hsv_channels[1];
-    cv::Mat value = hsv_channels[2];
-
-    // Apply thresholding on each channel
-    thresholdImage(hue, current_config.hue_min, current_config.hue_max);
-    thresholdImage(saturation, current_config.sat_min, current_config.sat_max);
-    thresholdImage(value, current_config.val_min, current_config.val_max);
-
-    // Special handling for hue (invert it)
-    cv::bitwise_not(hue, hue);
-
-    // Perform an AND on all three channels (hue, saturation, and value)
-    cv::Mat mask = hue & saturation & value;
-    cv::imshow("Filtered Frame", mask);
-
-    // Morphological operations: Erosion followed by Dilation
-   // cv::erode(mask, mask, cv::Mat(), cv::Point(-1, -1), 2);
-    //cv::dilate(mask, mask, cv::Mat(), cv::Point(-1, -1), 2);
-
-    // Find contours in the mask
-    std::vector<std::vector<cv::Point>> contours;
-    cv::findContours(mask, contours, cv::RETR_EXTERNAL, cv::CHAIN_APPROX_SIMPLE);
-
-    // Loop through contours to find the largest one (potential laser spot)
-    for (const auto& contour : contours) {
-        if (cv::contourArea(contour) < 5) continue; // Ignore small contours
-
-        // Calculate the centroid using image moments
-        cv::Moments m = cv::moments(contour);
-        if (m.m00 != 0) {
-            int cx = int(m.m10 / m.m00);
-            int cy = int(m.m01 / m.m00);
-
-            // Log the detected laser position (centroid)
-            //syslog(LOG_INFO, "Laser detected at x,y: %d, %d %d", cx, cy,current_config.behaviour);
-
-            // Mark the centroid on the frame
-            cv::circle(frame, cv::Point(cx, cy), 5, cv::Scalar(0, 255, 0), -1);
-            {
-            std::lock_guard<std::mutex> lock(point_mutex);
-            latest_laser_point = Point2D{cx, cy,current_config.behaviour };
-            point_available.store(true, std::memory_order_release);
-           
-            }
-        }
-       
-
-
-    }
-    service2_ok = true;
-    //syslog(LOG_INFO, "Service 2 OK set");
-
-
-//clock_gettime(CLOCK_REALTIME, &end);
-//delta_t(&end, &start, &exec);
-//double run_time = (exec.tv_sec * 1000.0) + (exec.tv_nsec / 1000000.0);
-
-//show to prof
-//syslog(LOG_INFO, "  run Execution Time    : %.3f ms (%.0f ns)", run_time, run_time * 1e6);
-//do not enable these | only for debugging enable
-	cv::imshow("Red Laser Detection", frame);
-    cv::waitKey(1);
-}
+#include "red_laser_service.hpp"
+#include "laser_mask.hpp"
+#include "colour_lut.hpp"
+#include "config_snapshot.hpp"
+#include "detect_stripes.hpp"
+#include "debug_view.hpp"
+#include <optional>
+#include <algorithm>
+#include <cstring>
+#include <chrono>
+#include <cmath>
+//default config
+#include "watchdog.hpp"
+
+
+DetectPath detect_path = DETECT_LUT;
+
+bool laser_roi_tracking = true;
+BlobScore blob_score = BLOB_LARGEST;
+LaserTrackStats laser_track_stats;
+int pyramid_level = 1;
+PyramidStats pyramid_stats;
+
+//search window covering every locked class track, clamped to the frame.
+//With no class locked the whole frame is searched; with some unlocked,
+//every ROI_REACQUIRE_FRAMES-th frame is, so a class that comes into view
+//away from the others is still found. x0 and the width stay even so the
+//window starts and ends on a YUYV macropixel.
+cv::Rect LaserDetector::_trackWindow(int width, int height, int class_count) const
+{
+    if (!laser_roi_tracking || class_count <= 0) return cv::Rect(0, 0, width, height);
+    int x0 = width, y0 = height, x1 = 0, y1 = 0;
+    bool unlocked = false;
+    for (int c = 0; c < class_count; ++c) {
+        const LaserTrack& t = _tracks[c];
+        if (!t.locked) {
+            unlocked = true;
+            continue;
+        }
+        x0 = std::min(x0, std::max(0, t.x - t.half) & ~1);
+        y0 = std::min(y0, std::max(0, t.y - t.half));
+        x1 = std::max(x1, std::min(width, (t.x + t.half + 1) & ~1));
+        y1 = std::max(y1, std::min(height, t.y + t.half));
+    }
+    if (x1 <= x0 || y1 <= y0) return cv::Rect(0, 0, width, height);
+    if (unlocked && _windowed_run >= ROI_REACQUIRE_FRAMES) return cv::Rect(0, 0, width, height);
+    return cv::Rect(x0, y0, x1 - x0, y1 - y0);
+}
+
+static void update_track(LaserTrack& t, LaserDetectInfo& info, bool found, int cx, int cy)
+{
+    if (found) {
+        if (!t.locked) info.acquired = true;
+        t.locked = true;
+        t.x = cx;
+        t.y = cy;
+        t.half = ROI_HALF_MIN;
+        t.misses = 0;
+    } else if (t.locked) {
+        if (++t.misses >= ROI_MAX_MISSES) {
+            t.locked = false;
+            info.lost = true;
+        } else {
+            t.half *= 2;
+        }
+    }
+}
+
+static void account_track(const LaserDetectInfo& info)
+{
+    laser_track_stats.frames.fetch_add(1, std::memory_order_relaxed);
+    laser_track_stats.pixels_scanned.fetch_add(info.pixels_scanned, std::memory_order_relaxed);
+    if (info.full_frame) {
+        laser_track_stats.full_frames.fetch_add(1, std::memory_order_relaxed);
+    } else {
+        laser_track_stats.window_frames.fetch_add(1, std::memory_order_relaxed);
+        laser_track_stats.window_pixels.fetch_add(info.pixels_scanned, std::memory_order_relaxed);
+        if (!info.found) laser_track_stats.misses.fetch_add(1, std::memory_order_relaxed);
+    }
+    if (info.acquired) laser_track_stats.acquisitions.fetch_add(1, std::memory_order_relaxed);
+    if (info.lost) laser_track_stats.losses.fetch_add(1, std::memory_order_relaxed);
+}
+
+void log_laser_track_stats()
+{
+    uint64_t frames = laser_track_stats.frames.load();
+    if (frames == 0) return;
+    uint64_t window_frames = laser_track_stats.window_frames.load();
+    syslog(LOG_INFO, "Laser Tracking Stats:");
+    syslog(LOG_INFO, "  Frames                : %llu (%llu windowed, %llu full)",
+           (unsigned long long)frames, (unsigned long long)window_frames,
+           (unsigned long long)laser_track_stats.full_frames.load());
+    syslog(LOG_INFO, "  Pixels scanned / frame: %llu",
+           (unsigned long long)(laser_track_stats.pixels_scanned.load() / frames));
+    if (window_frames) {
+        syslog(LOG_INFO, "  Mean window           : %llu px, %llu misses",
+               (unsigned long long)(laser_track_stats.window_pixels.load() / window_frames),
+               (unsigned long long)laser_track_stats.misses.load());
+    }
+    syslog(LOG_INFO, "  Acquisitions / losses : %llu / %llu",
+           (unsigned long long)laser_track_stats.acquisitions.load(),
+           (unsigned long long)laser_track_stats.losses.load());
+}
+
+void log_pyramid_stats()
+{
+    uint64_t frames = pyramid_stats.frames.load();
+    if (pyramid_level <= 1) return;
+    syslog(LOG_INFO, "Pyramid Stats (level %d):", pyramid_level);
+    syslog(LOG_INFO, "  Coarse-to-fine scans  : %llu, %llu fell back to full resolution",
+           (unsigned long long)frames, (unsigned long long)pyramid_stats.fallbacks.load());
+    if (frames) {
+        syslog(LOG_INFO, "  Refined / scan        : %.1f windows, %llu px",
+               double(pyramid_stats.windows.load()) / frames,
+               (unsigned long long)(pyramid_stats.refined_pixels.load() / frames));
+    }
+    uint64_t captured = std::max<uint64_t>(1, frame_copy_stats.frames_captured.load());
+    syslog(LOG_INFO, "  Pooling / frame       : %.3f ms", pyramid_stats.pool_ns.load() / 1e6 / captured);
+}
+
+static bool overlap(const cv::Rect& a, const cv::Rect& b)
+{
+    return a.x < b.x + b.width && b.x < a.x + a.width &&
+           a.y < b.y + b.height && b.y < a.y + a.height;
+}
+
+//grow overlapping windows into their union until none overlap
+static void merge_windows(std::vector<cv::Rect>& windows)
+{
+    for (size_t i = 0; i < windows.size(); ++i) {
+        for (size_t j = 0; j < windows.size(); ++j) {
+            if (j == i || !overlap(windows[i], windows[j])) continue;
+            cv::Rect& a = windows[i];
+            const cv::Rect& b = windows[j];
+            int x1 = std::max(a.x + a.width, b.x + b.width);
+            int y1 = std::max(a.y + a.height, b.y + b.height);
+            a.x = std::min(a.x, b.x);
+            a.y = std::min(a.y, b.y);
+            a.width = x1 - a.x;
+            a.height = y1 - a.y;
+            windows.erase(windows.begin() + j);
+            //the grown window is checked against all others again
+            if (j < i) --i;
+            j = size_t(-1);
+        }
+    }
+}
+
+//coarse-to-fine scan of the whole frame. A dot wider and taller than a
+//block has its class bit in at least one sampled block; its edge pixels
+//can lie in blocks that were not hit, so each window takes one block
+//more on every side. Blobs reaching further out than that, or too small
+//to hit a sample, differ from a full-frame scan. False if the frame has
+//no matching sampled mask or too many candidates; the caller scans the
+//frame the normal way then.
+bool LaserDetector::_pyramidBlobs(const FrameHandle& handle, const ColourLut& lut,
+                                  std::vector<Blob>& blobs, uint32_t& pixels)
+{
+    const CoarseMask& coarse = handle.coarse();
+    if (!coarse.valid || coarse.level != pyramid_level || coarse.lut_generation != lut.generation) {
+        pyramid_stats.fallbacks.fetch_add(1, std::memory_order_relaxed);
+        return false;
+    }
+
+    cv::Mat pooled(coarse.height, coarse.width, CV_8UC1, const_cast<uint8_t*>(coarse.bits.data()));
+    if (_coarse_labeller.label(pooled, nullptr, 0, 1) > PYRAMID_MAX_CANDIDATES) {
+        pyramid_stats.fallbacks.fetch_add(1, std::memory_order_relaxed);
+        return false;
+    }
+
+    _windows.clear();
+    for (const Blob& b : _coarse_labeller.blobs()) {
+        int x0 = std::max(0, (b.x0 - 1) * coarse.level), y0 = std::max(0, (b.y0 - 1) * coarse.level);
+        int x1 = std::min(handle.width(), (b.x1 + 2) * coarse.level);
+        int y1 = std::min(handle.height(), (b.y1 + 2) * coarse.level);
+        _windows.emplace_back(x0, y0, x1 - x0, y1 - y0);
+    }
+    merge_windows(_windows);
+
+    blobs.clear();
+    pixels = uint32_t(coarse.width) * coarse.height;
+    for (const cv::Rect& w : _windows) {
+        const uint8_t* p = handle.data() + size_t(w.y) * handle.stride() + size_t(w.x) * 2;
+        mask_from_lut(p, w.width, w.height, handle.stride(), lut, _refine_mask);
+        _refine_labeller.label(_refine_mask, p, handle.stride());
+        for (Blob b : _refine_labeller.blobs()) {
+            b.translate(w.x, w.y);
+            blobs.push_back(b);
+        }
+        pixels += uint32_t(w.width) * w.height;
+        pyramid_stats.refined_pixels.fetch_add(uint64_t(w.width) * w.height, std::memory_order_relaxed);
+    }
+    pyramid_stats.frames.fetch_add(1, std::memory_order_relaxed);
+    pyramid_stats.windows.fetch_add(_windows.size(), std::memory_order_relaxed);
+    return true;
+}
+
+bool parse_detect_path(const char* name, DetectPath& path)
+{
+    if (strcmp(name, "lut") == 0) path = DETECT_LUT;
+    else if (strcmp(name, "yuyv") == 0) path = DETECT_YUYV;
+    else if (strcmp(name, "bgr") == 0) path = DETECT_BGR;
+    else return false;
+    return true;
+}
+
+    int delta_t(struct timespec *stop, struct timespec *start, struct timespec *delta_t)
+    {
+        int dt_sec = stop->tv_sec - start->tv_sec;
+        int dt_nsec = stop->tv_nsec - start->tv_nsec;
+
+        if (dt_sec >= 0)
+        {
+            if (dt_nsec >= 0)
+            {
+                delta_t->tv_sec = dt_sec;
+                delta_t->tv_nsec = dt_nsec;
+            }
+            else
+            {
+                delta_t->tv_sec = dt_sec - 1;
+                delta_t->tv_nsec = NSEC_PER_SEC + dt_nsec;
+            }
+        }
+        else
+        {
+            if (dt_nsec >= 0)
+            {
+                delta_t->tv_sec = dt_sec;
+                delta_t->tv_nsec = dt_nsec;
+            }
+            else
+            {
+                delta_t->tv_sec = dt_sec - 1;
+                delta_t->tv_nsec = NSEC_PER_SEC + dt_nsec;
+            }
+        }
+
+        return (1);
+    }
+    
+
+
+void LaserDetector::detect(FrameChannel& frames, Channel<Point2D>& points, Channel<ClassPoints>& class_points_out){
+	
+	    
+    //the config current now, a reload is picked up here and nowhere else
+    const ConfigSnapshot* snapshot = config_store.acquire(camera_reader(CONFIG_READER_DETECT, _camera));
+    if (!snapshot) return;
+    const HSVConfig& current_config = snapshot->hsv;
+
+    //take ownership of the newest frame, the camera buffer stays out of the
+    //driver queue until we are done with it
+    FrameHandle handle;
+    if (!frames.take(handle)) return;
+    FrameTrace trace;
+    trace.sequence = handle.sequence();
+    trace.exposed_ns = handle.ready_ns();
+    trace.dequeued_ns = handle.capture_ns();
+    trace.published_ns = handle.published_ns();
+    trace.taken_ns = steady_ns();
+    //the reload latency ends at the first camera's detector
+    if (snapshot->generation != _applied_generation) {
+        _applied_generation = snapshot->generation;
+        if (_camera == 0) config_store.noteFirstFrame(*snapshot);
+    }
+
+    //a still scene gives the same answer again: reuse the last result when
+    //no tile moved since the last detected frame and the config is the same
+    change_gate_stats.frames.fetch_add(1, std::memory_order_relaxed);
+    if (change_threshold > 0 && snapshot->generation == _detected_generation &&
+        !signature_changed(handle.signature(), _detected_signature, change_threshold)) {
+        if (_skipped_run < CHANGE_MAX_SKIP) {
+            ++_skipped_run;
+            change_gate_stats.skipped.fetch_add(1, std::memory_order_relaxed);
+            //the decision service consumes the point, hand the old one back
+            if (_last_found) {
+                _last_point.trace = trace;
+                _last_point.trace.detected_ns = steady_ns();
+                points.publish(_last_point);
+            }
+            service2_ok = true;
+            return;
+        }
+        change_gate_stats.forced.fetch_add(1, std::memory_order_relaxed);
+    }
+    _skipped_run = 0;
+    if (change_threshold > 0) {
+        _detected_signature = handle.signature();
+        _detected_generation = snapshot->generation;
+    }
+    auto detect_start = std::chrono::steady_clock::now();
+    //most execution overhead due to this 
+//clock_gettime(CLOCK_REALTIME, &start);
+    //wrap the mmap'd YUYV data without copying. The BGR image is only
+    //produced for the OpenCV fallback path, the debug view converts its
+    //own copy off the RT core.
+    uint64_t bgr_bytes = uint64_t(handle.width()) * handle.height() * 3;
+    frame_copy_stats.frames_detected.fetch_add(1, std::memory_order_relaxed);
+    frame_copy_stats.bytes_copied_legacy.fetch_add(3 * bgr_bytes, std::memory_order_relaxed);
+    cv::Mat yuyv(handle.height(), handle.width(), CV_8UC2,
+                 const_cast<uint8_t*>(handle.data()), handle.stride());
+
+    //only the window around the tracked targets is classified, the mask
+    //covers the window and blob coordinates are offset back
+    int class_count = current_config.class_count;
+    cv::Rect window = _trackWindow(handle.width(), handle.height(), class_count);
+    LaserDetectInfo info{};
+    info.window_w = window.width;
+    info.window_h = window.height;
+    info.pixels_scanned = uint32_t(window.width) * window.height;
+    info.full_frame = window.width == handle.width() && window.height == handle.height();
+    _windowed_run = info.full_frame ? 0 : _windowed_run + 1;
+    const uint8_t* window_yuyv = handle.data() + size_t(window.y) * handle.stride() + size_t(window.x) * 2;
+
+    //the snapshot's table always matches its thresholds
+    const ColourLut* lut = detect_path == DETECT_LUT ? &snapshot->lut : nullptr;
+    //one raster pass labels every class of the mask and sums
+    //area/moments/luma per blob, the best blob of each class under
+    //blob_score is published once per frame. Large
+    //windows are split into stripes over the worker pool.
+    const std::vector<Blob>* blobs = &_labeller.blobs();
+    bool masked = true;     //false when no window-sized mask was built
+    if (lut && pyramid_level > 1 && info.full_frame &&
+        _pyramidBlobs(handle, *lut, _pyramid_out, info.pixels_scanned)) {
+        blobs = &_pyramid_out;
+        masked = false;
+    } else if (detect_path != DETECT_BGR && stripe_pool.stripes_for(window.height) > 1) {
+        StripeJob job{window_yuyv, window.width, window.height, handle.stride(), lut,
+                      &snapshot->thresholds, &_mask};
+        stripe_pool.run(job, BLOB_MIN_AREA, _stripe_blobs);
+        blobs = &_stripe_blobs;
+    } else {
+        if (detect_path == DETECT_BGR) {
+            cv::cvtColor(yuyv(window), _roi_bgr, cv::COLOR_YUV2BGR_YUYV);
+            frame_copy_stats.bytes_copied.fetch_add(uint64_t(info.pixels_scanned) * 3,
+                                                    std::memory_order_relaxed);
+            mask_from_bgr(_roi_bgr, current_config, _mask);
+        } else if (lut) {
+            mask_from_lut(window_yuyv, window.width, window.height, handle.stride(), *lut, _mask);
+        } else {
+            mask_from_yuyv(window_yuyv, window.width, window.height, handle.stride(),
+                           snapshot->thresholds, _mask);
+        }
+        _labeller.label(_mask, window_yuyv, handle.stride());
+    }
+
+    // Morphological operations: Erosion followed by Dilation
+   // cv::erode(mask, mask, cv::Mat(), cv::Point(-1, -1), 2);
+    //cv::dilate(mask, mask, cv::Mat(), cv::Point(-1, -1), 2);
+
+    ClassDetection found[MAX_COLOUR_CLASSES]{};
+    int primary = -1;
+    for (int c = 0; c < class_count; ++c) {
+        LaserTrack& t = _tracks[c];
+        const Blob* best = best_blob(*blobs, c, blob_score, t.locked, t.x - window.x, t.y - window.y);
+        if (best) {
+            found[c] = {true, float(window.x + best->cx()), float(window.y + best->cy()), best->area};
+            if (primary < 0) primary = c;
+        }
+        update_track(t, info, found[c].found, int(found[c].x), int(found[c].y));
+    }
+
+    //the first class in config order that was seen drives the robot, the
+    //rest are published alongside for whoever wants them. Both go out in
+    //POINT_FRAME_WIDTH x POINT_FRAME_HEIGHT units, the tracks stay in pixels.
+    float sx = float(POINT_FRAME_WIDTH) / handle.width();
+    float sy = float(POINT_FRAME_HEIGHT) / handle.height();
+    ClassPoints class_points;
+    for (int c = 0; c < MAX_COLOUR_CLASSES; ++c) {
+        const ClassDetection& d = found[c];
+        class_points.points[c] = {d.found, d.x * sx, d.y * sy, uint32_t(std::lround(d.area * sx * sy))};
+    }
+    class_points_out.publish(class_points);
+    float track_x = 0, track_y = 0;
+    if (primary >= 0) {
+        track_x = found[primary].x;
+        track_y = found[primary].y;
+        // Log the detected laser position (centroid)
+        //syslog(LOG_INFO, "Laser detected at x,y: %.1f, %.1f %d", track_x, track_y, primary);
+        _last_point = Point2D{track_x * sx, track_y * sy, current_config.classes[primary].behaviour,
+                              handle.capture_ns(), trace,
+                              uint32_t(std::lround(found[primary].area * sx * sy)), _camera};
+        _last_point.trace.detected_ns = steady_ns();
+        points.publish(_last_point);
+    }
+    info.found = primary >= 0;
+    _last_found = info.found;
+    account_track(info);
+    _last_info = info;
+    cv::Rect next = _trackWindow(handle.width(), handle.height(), class_count);
+    _full_scan_next.store(next.width == handle.width() && next.height == handle.height(),
+                          std::memory_order_relaxed);
+    service2_ok = true;
+    //syslog(LOG_INFO, "Service 2 OK set");
+
+
+//clock_gettime(CLOCK_REALTIME, &end);
+//delta_t(&end, &start, &exec);
+//double run_time = (exec.tv_sec * 1000.0) + (exec.tv_nsec / 1000000.0);
+
+//show to prof
+//syslog(LOG_INFO, "  run Execution Time    : %.3f ms (%.0f ns)", run_time, run_time * 1e6);
+//no GUI work on this thread: the debug view is drawn on another core, and
+//shows the first camera only
+    if (_camera == 0 && debug_view.active()) {
+        debug_view.post(handle, masked ? _mask : cv::Mat(), window, info.found, int(track_x), int(track_y));
+    }
+    change_gate_stats.detect_ns.fetch_add(
+        std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - detect_start).count(),
+        std::memory_order_relaxed);
+}
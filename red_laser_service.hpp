@@ -1,46 +1,216 @@
-#pragma once
-#include <mutex>
-#include <linux/videodev2.h>
-#include <opencv2/opencv.hpp>
-#include <syslog.h>
-#include <optional>
-#include <atomic>
-
-#define NSEC_PER_SEC (1000000000)
-
-struct HSVConfig {
-    int hue_min, hue_max;
-    int sat_min, sat_max;
-    int val_min, val_max;
-    int behaviour;
-    
-    HSVConfig() {
-        hue_min = 20;
-        hue_max = 160;
-        sat_min = 100;
-        sat_max = 255;
-        val_min = 200;
-        val_max = 255;
-        behaviour=1;
-    }
-};
-
-
-
-struct Point2D {
-    int x;
-    int y;
-    int behav;
-};
-
-extern std::mutex config_mutex;
-extern HSVConfig config; 
-
-extern cv::Mat latest_frame;
-extern std::mutex frame_mutex;
-
-extern std::optional<Point2D> latest_laser_point;
-extern std::mutex point_mutex;
-extern std::atomic<bool> point_available; 
-
-void red_laser_detect();
+#pragma once
+#include <mutex>
+#include <linux/videodev2.h>
+#include <opencv2/opencv.hpp>
+#include <syslog.h>
+#include <optional>
+#include <atomic>
+#include "frame_ring.hpp"
+#include "blob_label.hpp"
+#include "pipeline.hpp"
+#include "latency_trace.hpp"
+
+#define NSEC_PER_SEC (1000000000)
+
+//every class gets one bit in the mask, so at most 8
+#define MAX_COLOUR_CLASSES 8
+#define MAX_CLASS_RANGES   4
+#define CLASS_NAME_LEN     16
+
+//one HSV box, inclusive on both ends like cv::inRange
+struct HSVRange {
+    int lower[3];
+    int upper[3];
+
+    bool operator==(const HSVRange&) const = default;
+};
+
+//a named colour made of one or more boxes (red needs two hue ranges)
+struct ColourClass {
+    char name[CLASS_NAME_LEN];
+    HSVRange ranges[MAX_CLASS_RANGES];
+    int range_count;
+    int behaviour;
+
+    bool operator==(const ColourClass&) const = default;
+};
+
+//fixed size, a copy of it is part of every config snapshot (config_snapshot.hpp)
+struct HSVConfig {
+    ColourClass classes[MAX_COLOUR_CLASSES];
+    int class_count;
+
+    //the original single laser colour: hue outside 20..160, sat 100..255, val 200..255
+    HSVConfig();
+
+    bool operator==(const HSVConfig&) const = default;
+};
+
+//the original "colour" entry: thresholdImage() semantics (min < x <= max,
+//a negative min passes everything) with the hue range inverted
+ColourClass legacy_colour_class(const char* name, int hue_min, int hue_max, int sat_min,
+                                int sat_max, int val_min, int val_max, int behaviour);
+
+
+
+//points are published in this frame size whatever mode the camera runs
+//in, so the decision map, the tracker and the fusion stage keep their
+//640x480 units
+#define POINT_FRAME_WIDTH  640
+#define POINT_FRAME_HEIGHT 480
+
+//sub-pixel centroid (m10/m00, m01/m00) of the frame captured at t_ns
+//(steady clock), see FrameHandle::capture_ns(). `trace` is the frame the
+//point was published for, which differs from t_ns when the change gate
+//hands an earlier point on again. `area` is the blob's pixel count and
+//`camera` the index of the camera that saw it, for the fusion stage.
+//Coordinates and area are scaled to POINT_FRAME_WIDTH x POINT_FRAME_HEIGHT.
+struct Point2D {
+    float x;
+    float y;
+    int behav;
+    uint64_t t_ns;
+    FrameTrace trace;
+    uint32_t area = 0;
+    int camera = 0;
+};
+
+
+
+//one centroid per configured class, found or not, from the same frame,
+//scaled like Point2D; the point the detector publishes is the first class
+//(in config order) that was found
+struct ClassDetection {
+    bool found;
+    float x, y;
+    uint32_t area;
+};
+struct ClassPoints {
+    ClassDetection points[MAX_COLOUR_CLASSES];
+};
+
+//how the laser mask is built, see laser_mask.hpp
+enum DetectPath {
+    DETECT_BGR,     // YUYV->BGR->HSV with OpenCV, the original chain
+    DETECT_YUYV,    // classify straight from the packed YUYV buffer
+    DETECT_LUT      // one colour_lut.hpp table lookup per pixel
+};
+extern DetectPath detect_path;
+
+//"lut", "yuyv" or "bgr", false if unknown
+bool parse_detect_path(const char* name, DetectPath& path);
+
+//once the dot is found only a window around its last position is
+//scanned; each miss doubles the window, after ROI_MAX_MISSES misses in
+//a row the detector goes back to scanning the full frame. With several
+//classes the window covers the locked ones; the classes not in view are
+//looked for in a full scan every ROI_REACQUIRE_FRAMES windowed frames.
+#define ROI_HALF_MIN   32       //initial window is 64x64
+#define ROI_MAX_MISSES 3
+#define ROI_REACQUIRE_FRAMES 8
+extern bool laser_roi_tracking;
+
+//coarse-to-fine full-frame scans (lut path only): the capture service
+//classifies one macropixel per pyramid_level x pyramid_level block, the
+//detector labels that and classifies full resolution pixels only inside
+//the candidates' blocks and one block around them. 1 turns it off,
+//otherwise 2 or 4. A dot must be more than pyramid_level pixels across
+//to be seen. With more than PYRAMID_MAX_CANDIDATES coarse blobs the whole
+//frame is scanned instead.
+#define PYRAMID_MAX_CANDIDATES 16
+extern int pyramid_level;
+
+struct PyramidStats {
+    std::atomic<uint64_t> frames{0};            //full-frame scans done coarse-to-fine
+    std::atomic<uint64_t> fallbacks{0};         //too many candidates or no pooled mask
+    std::atomic<uint64_t> windows{0};           //refined windows, after merging
+    std::atomic<uint64_t> refined_pixels{0};
+    std::atomic<uint64_t> pool_ns{0};           //capture side sampling
+};
+extern PyramidStats pyramid_stats;
+
+void log_pyramid_stats();
+
+//which blob is the laser when the mask has several, see blob_label.hpp
+extern BlobScore blob_score;
+
+//what the last LaserDetector::detect() call did
+struct LaserDetectInfo {
+    uint32_t pixels_scanned;
+    int window_w, window_h;     //equal to the frame size on a full scan
+    bool full_frame;
+    bool found;                 //any class was seen
+    bool acquired;              //a class was found again, its tracking starts
+    bool lost;                  //a class missed too often, next frame is a full scan
+};
+
+struct LaserTrackStats {
+    std::atomic<uint64_t> frames{0};
+    std::atomic<uint64_t> pixels_scanned{0};
+    std::atomic<uint64_t> full_frames{0};
+    std::atomic<uint64_t> window_frames{0};
+    std::atomic<uint64_t> window_pixels{0};     //sum of window areas
+    std::atomic<uint64_t> misses{0};
+    std::atomic<uint64_t> acquisitions{0};
+    std::atomic<uint64_t> losses{0};            //fallbacks to a full-frame scan
+};
+extern LaserTrackStats laser_track_stats;
+
+void log_laser_track_stats();
+
+struct ColourLut;
+
+//where a class was last seen and how wide to look around it
+struct LaserTrack {
+    bool locked = false;
+    int x = 0, y = 0;
+    int half = ROI_HALF_MIN;
+    int misses = 0;
+};
+
+//the detector of one camera: its class tracks, change gate state and
+//scratch buffers, so the detectors of several cameras run side by side.
+//The counters above are shared and sum over all of them.
+class LaserDetector {
+public:
+    explicit LaserDetector(int camera = 0) : _camera(camera) {}
+
+    //takes the newest frame from `frames`, publishes the primary class's
+    //point to `points` and every class to `class_points`
+    void detect(FrameChannel& frames, Channel<Point2D>& points, Channel<ClassPoints>& class_points);
+
+    //the next detection scans the whole frame, so capture should pool the mask
+    bool fullScanNext() const { return _full_scan_next.load(std::memory_order_relaxed); }
+
+    const LaserDetectInfo& lastInfo() const { return _last_info; }
+
+private:
+    cv::Rect _trackWindow(int width, int height, int class_count) const;
+    bool _pyramidBlobs(const FrameHandle& handle, const ColourLut& lut,
+                       std::vector<Blob>& blobs, uint32_t& pixels);
+
+    int _camera;
+    LaserTrack _tracks[MAX_COLOUR_CLASSES];
+    int _windowed_run = 0;      //windowed frames since the last full scan
+    std::atomic<bool> _full_scan_next{true};
+    LaserDetectInfo _last_info{};
+
+    //config generation seen last, for the reload latency
+    uint64_t _applied_generation = 0;
+
+    //change gate: the last detected frame and its answer
+    FrameSignature _detected_signature;
+    uint64_t _detected_generation = 0;
+    int _skipped_run = 0;
+    bool _last_found = false;
+    Point2D _last_point{};
+
+    //scratch, reused every frame
+    cv::Mat _roi_bgr;
+    cv::Mat _mask;
+    BlobLabeller _labeller;
+    std::vector<Blob> _stripe_blobs, _pyramid_out;
+    BlobLabeller _coarse_labeller, _refine_labeller;
+    std::vector<cv::Rect> _windows;
+    cv::Mat _refine_mask;
+};
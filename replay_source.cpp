@@ -0,0 +1,168 @@
+/***************************************************************
+ * File: replay_source.cpp
+ * Description: Memory-mapped replay of raw YUYV recordings.
+ ***************************************************************/
+
+#include "replay_source.hpp"
+
+#include <cstdlib>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <syslog.h>
+#include <thread>
+#include <unistd.h>
+
+ReplaySource::ReplaySource(const char* path, bool realtime, bool loop)
+    : _path(path), _realtime(realtime), _loop(loop)
+{
+}
+
+ReplaySource::~ReplaySource()
+{
+    if (_map) munmap(_map, _map_length);
+    if (_fd >= 0) close(_fd);
+}
+
+int ReplaySource::open()
+{
+    _fd = ::open(_path, O_RDONLY);
+    if (_fd < 0) {
+        syslog(LOG_ERR, "Replay: cannot open %s", _path);
+        return EXIT_FAILURE;
+    }
+
+    struct stat st;
+    if (fstat(_fd, &st) != 0 || size_t(st.st_size) < sizeof(RecordingHeader)) {
+        syslog(LOG_ERR, "Replay: %s is not a recording", _path);
+        return EXIT_FAILURE;
+    }
+
+    _map_length = st.st_size;
+    void* map = mmap(NULL, _map_length, PROT_READ, MAP_PRIVATE, _fd, 0);
+    if (map == MAP_FAILED) {
+        syslog(LOG_ERR, "Replay: mmap failed");
+        return EXIT_FAILURE;
+    }
+    _map = static_cast<uint8_t*>(map);
+
+    std::memcpy(&_header, _map, sizeof(_header));
+    if (!recording_header_valid(_header) || _header.data_offset > _map_length ||
+        uint64_t(_header.count) * _header.frame_bytes > _map_length - _header.data_offset) {
+        syslog(LOG_ERR, "Replay: %s has a bad header or is truncated", _path);
+        return EXIT_FAILURE;
+    }
+    if (_header.count == 0) {
+        syslog(LOG_ERR, "Replay: %s holds no frames", _path);
+        return EXIT_FAILURE;
+    }
+    _index = reinterpret_cast<const RecordingIndexEntry*>(_map + sizeof(RecordingHeader));
+
+    for (int i = 0; i < REPLAY_SLOTS; ++i) {
+        FrameSlot& slot = _slots[i];
+        slot.width = _header.width;
+        slot.height = _header.height;
+        slot.stride = _header.stride;
+        slot.length = _header.frame_bytes;
+        slot.source = this;
+        slot.buf.index = i;
+        slot.coarse.reserve(slot.width, slot.height);
+    }
+
+    // sequential access, let the kernel read ahead
+    madvise(_map, _map_length, MADV_SEQUENTIAL);
+
+    // the frame rate it was recorded at, the pipeline is timed off it
+    uint64_t first_us = _index[0].timestamp_us, last_us = _index[_header.count - 1].timestamp_us;
+    _interval_ns = _header.count > 1 && last_us > first_us ? (last_us - first_us) * 1000 / (_header.count - 1) : 0;
+
+    syslog(LOG_INFO, "Replay: %s, %u frames %ux%u at %.2f fps, %s", _path, _header.count,
+           _header.width, _header.height, _interval_ns ? 1e9 / _interval_ns : 0.0,
+           _realtime ? "recorded pace" : "as fast as possible");
+    return EXIT_SUCCESS;
+}
+
+bool ReplaySource::grab(FrameHandle& frame)
+{
+    if (_next >= _header.count) {
+        if (!_loop) {
+            _finished.store(true, std::memory_order_release);
+            return false;
+        }
+        _next = 0;
+    }
+
+    const RecordingIndexEntry& entry = _index[_next];
+    auto now = std::chrono::steady_clock::now();
+    auto ready = now;
+    if (_next == 0) {
+        _wall_base = now;
+        _ts_base_us = entry.timestamp_us;
+    } else if (_realtime) {
+        auto due = _wall_base + std::chrono::microseconds(entry.timestamp_us - _ts_base_us);
+        if (now < due) return false;
+        ready = due;
+    }
+
+    // a slot is free once every consumer dropped its handle
+    FrameSlot* slot = nullptr;
+    for (FrameSlot& candidate : _slots) {
+        if (candidate.refs.load(std::memory_order_acquire) == 0) {
+            slot = &candidate;
+            break;
+        }
+    }
+    if (!slot) return false;
+
+    slot->start = _map + _header.data_offset + uint64_t(_next) * _header.frame_bytes;
+    slot->buf.sequence = entry.sequence;
+    slot->buf.bytesused = entry.bytesused;
+    slot->buf.timestamp.tv_sec = entry.timestamp_us / 1000000;
+    slot->buf.timestamp.tv_usec = entry.timestamp_us % 1000000;
+    slot->ready_ns = std::chrono::duration_cast<std::chrono::nanoseconds>(ready.time_since_epoch()).count();
+    if (++_next >= _header.count && !_loop) _finished.store(true, std::memory_order_release);
+
+    frame = FrameHandle(slot);
+    return true;
+}
+
+// At the recorded pace a frame is ready once its timestamp is due; as
+// fast as possible, always. Either way only once a slot is free to take it.
+bool ReplaySource::wait(int timeout_ms)
+{
+    auto until = std::chrono::steady_clock::now() + std::chrono::milliseconds(timeout_ms);
+    if (finished()) {
+        std::this_thread::sleep_until(until);
+        return false;
+    }
+    if (waitForRelease(timeout_ms) < 0) return false;
+    auto now = std::chrono::steady_clock::now();
+    uint32_t next = _next >= _header.count ? 0 : _next;
+    if (!_realtime || next == 0) return true;
+
+    auto due = _wall_base + std::chrono::microseconds(_index[next].timestamp_us - _ts_base_us);
+    if (due <= now) return true;
+    if (due > until) {
+        std::this_thread::sleep_until(until);
+        return false;
+    }
+    std::this_thread::sleep_until(due);
+    return true;
+}
+
+FrameFormat ReplaySource::format() const
+{
+    FrameFormat f;
+    f.pixelformat = _header.pixelformat;
+    f.width = _header.width;
+    f.height = _header.height;
+    f.stride = _header.stride;
+    f.frame_bytes = _header.frame_bytes;
+    f.frame_interval_ns = _interval_ns;
+    return f;
+}
+
+void ReplaySource::release(FrameSlot&)
+{
+    // the mapping stays valid, nothing to hand back
+}
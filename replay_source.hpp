@@ -0,0 +1,55 @@
+/***************************************************************
+ * File: replay_source.hpp
+ * Description: Frame source that replays a raw YUYV recording
+ *              (see recording_format.hpp) from a read-only memory
+ *              mapping. Frames are served either at the recorded pace
+ *              or as fast as the capture service asks for them.
+ ***************************************************************/
+
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include "frame_source.hpp"
+#include "recording_format.hpp"
+
+// Slots only point into the mapping, so there are enough for every
+// consumer at once, see capture_buffers_needed()
+#define REPLAY_SLOTS 8
+
+class ReplaySource : public FrameSource {
+public:
+    // realtime: honour recorded timestamps; loop: rewind at end of file
+    ReplaySource(const char* path, bool realtime, bool loop = false);
+    ~ReplaySource() override;
+
+    int open() override;
+    bool grab(FrameHandle& frame) override;
+    bool wait(int timeout_ms) override;
+    void release(FrameSlot& slot) override;
+    const char* name() const override { return _path; }
+    FrameFormat format() const override;
+    bool finished() const override { return _finished.load(std::memory_order_acquire); }
+    // as fast as possible, the next frame is simply always there
+    int buffers() const override { return _realtime ? REPLAY_SLOTS : 0; }
+    bool starved() const override { return all_slots_held(_slots, REPLAY_SLOTS); }
+
+    uint32_t frame_count() const { return _header.count; }
+
+private:
+    const char* _path;
+    bool _realtime;
+    bool _loop;
+    int _fd = -1;
+    uint8_t* _map = nullptr;
+    size_t _map_length = 0;
+    RecordingHeader _header{};
+    const RecordingIndexEntry* _index = nullptr;
+    uint32_t _next = 0;                 // capture thread only
+    std::atomic<bool> _finished{false}; // last frame served, read by main too
+    std::chrono::steady_clock::time_point _wall_base;
+    uint64_t _ts_base_us = 0;
+    uint64_t _interval_ns = 0;      // mean of the recorded timestamps
+    FrameSlot _slots[REPLAY_SLOTS];
+};
@@ -23,10 +23,10 @@
  #include <sys/ioctl.h>
  
  // Atomic flags updated by each service upon successful execution
- std::atomic<bool> service1_ok{false};
- std::atomic<bool> service2_ok{false};
- std::atomic<bool> service3_ok{false};
- std::atomic<bool> service4_ok{false};
+ alignas(64) std::atomic<bool> service1_ok{false};
+ alignas(64) std::atomic<bool> service2_ok{false};
+ alignas(64) std::atomic<bool> service3_ok{false};
+ alignas(64) std::atomic<bool> service4_ok{false};
  
  /**
   * @brief Monitors services and kicks the hardware watchdog if all are OK.
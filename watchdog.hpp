@@ -17,11 +17,12 @@
  
  #include <atomic>
  
- // Flags set to true by each core service if it executed successfully
- extern std::atomic<bool> service1_ok;
- extern std::atomic<bool> service2_ok;
- extern std::atomic<bool> service3_ok;
- extern std::atomic<bool> service4_ok;
+ // Flags set to true by each core service if it executed successfully,
+ // one cache line each so the services do not false-share
+ alignas(64) extern std::atomic<bool> service1_ok;
+ alignas(64) extern std::atomic<bool> service2_ok;
+ alignas(64) extern std::atomic<bool> service3_ok;
+ alignas(64) extern std::atomic<bool> service4_ok;
  
  /**
   * @brief Periodic function executed by the Sequencer on Core 2.